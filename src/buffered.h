@@ -0,0 +1,299 @@
+/**********************************************************
+ * Buffered load analysis of Load Inspector (-buffered)
+ * The application thread only appends a compact record of
+ * each load to a per-thread buffer; full buffers are analyzed
+ * by internal worker threads. A thread's records are analyzed
+ * in order and into its own shard, so the results are those
+ * of the inline analysis.
+ **********************************************************/
+
+#ifndef BUFFERED_H
+#define BUFFERED_H
+
+#include "stats.h"
+
+//-------------------------------//
+// One load, followed by its address and its value in 8-byte
+// words unless count_only. Scalar values are zero-extended to
+// a word, so a scalar record is 24 bytes and a count-only one 8.
+//-------------------------------//
+typedef struct
+{
+    uint32_t slot;
+    uint8_t load_type;
+    uint8_t sizeb;
+    uint8_t count_only;     // known unstable or untracked size
+    uint8_t reserved;
+} load_record_t;
+
+static inline uint32_t load_record_bytes(uint32_t sizeb, BOOL count_only)
+{
+    if (count_only)
+        return sizeof(load_record_t);
+    return sizeof(load_record_t) + sizeof(uint64_t)
+           + (sizeb < NUM_SCALAR_LOAD_SIZES ? sizeof(uint64_t) : (1u << sizeb));
+}
+
+static inline uint64_t* load_record_words(load_record_t* rec)
+{
+    return (uint64_t*)(rec + 1);
+}
+
+static inline const uint64_t* load_record_words(const load_record_t* rec)
+{
+    return (const uint64_t*)(rec + 1);
+}
+
+//-------------------------------//
+// Ring of buffers of one application thread
+// The thread fills one buffer while earlier ones wait for or
+// go through analysis. Batches are analyzed under the ring's
+// lock, by a worker or, when the ring is full, by the thread
+// itself.
+//-------------------------------//
+typedef struct
+{
+    char* cur = NULL;               // next record of the buffer being filled
+    char* end = NULL;
+    char** buffers = NULL;          // load_buffer_count of them
+    uint64_t* used = NULL;          // bytes of each submitted buffer
+    volatile uint64_t submitted = 0;    // buffers handed over for analysis
+    volatile uint64_t processed = 0;    // of them, analyzed
+    PIN_LOCK lock;
+
+    // written by the application thread only
+    uint64_t records = 0;
+    uint64_t fill_bytes = 0;        // summed over submitted buffers
+    uint64_t queue_depth = 0;       // batches waiting at each submit, summed
+    uint64_t stalls = 0;            // submits that found the ring full
+    uint64_t stall_cycles = 0;
+    uint64_t inline_batches = 0;    // batches the thread analyzed itself
+} __attribute__((aligned(64))) load_buffer_t;
+
+static uint64_t load_buffer_bytes = 0;  // zero: inline analysis
+static uint32_t load_buffer_count = 0;
+static uint32_t num_load_workers = 0;
+static load_buffer_t load_buffers[PIN_MAX_THREADS];
+
+static volatile BOOL load_workers_stop = FALSE;
+static std::vector<PIN_THREAD_UID> load_worker_uids;
+static std::vector<CACHELINE_COUNTER> load_worker_batches;
+
+// Idle polls of a worker before it sleeps between polls
+const uint32_t LOAD_WORKER_SPIN = 1000;
+
+// Analyzes one record into the shard of its thread; set by the tool
+typedef VOID (*replay_record_fn_t)(THREADID tid, thread_stats_t* ts, const load_record_t* rec);
+static replay_record_fn_t replay_load_record = NULL;
+
+static void analyze_load_batch(THREADID tid, const char* data, uint64_t bytes)
+{
+    thread_stats_t* ts = thread_stats[tid];
+    for (const char* p = data; p < data + bytes;)
+    {
+        const load_record_t* rec = (const load_record_t*)p;
+        replay_load_record(tid, ts, rec);
+        p += load_record_bytes(rec->sizeb, rec->count_only);
+    }
+}
+
+// Analyzes, in order, the batches a thread submitted so far;
+// safe to call from any thread. Returns the batches analyzed.
+static uint64_t drain_load_batches(THREADID tid)
+{
+    load_buffer_t& lb = load_buffers[tid];
+    uint64_t batches = 0;
+
+    PIN_GetLock(&lb.lock, PIN_ThreadId() + 1);
+    uint64_t submitted = __atomic_load_n(&lb.submitted, __ATOMIC_ACQUIRE);
+    for (uint64_t n = lb.processed; n < submitted; n++, batches++)
+    {
+        uint32_t b = n % load_buffer_count;
+        analyze_load_batch(tid, lb.buffers[b], lb.used[b]);
+        __atomic_store_n(&lb.processed, n + 1, __ATOMIC_RELEASE);
+    }
+    PIN_ReleaseLock(&lb.lock);
+    return batches;
+}
+
+//-------------------------------//
+// Hands the buffer being filled over for analysis and moves on
+// to the next one. If that one still waits for analysis, the
+// workers fell behind, and the thread catches up by itself.
+// Called by the thread owning the ring.
+//-------------------------------//
+static void submit_load_buffer(THREADID tid)
+{
+    load_buffer_t& lb = load_buffers[tid];
+    uint64_t n = lb.submitted;
+    uint32_t b = n % load_buffer_count;
+
+    lb.used[b] = lb.cur - lb.buffers[b];
+    lb.fill_bytes += lb.used[b];
+    lb.queue_depth += n - __atomic_load_n(&lb.processed, __ATOMIC_ACQUIRE);
+    __atomic_store_n(&lb.submitted, n + 1, __ATOMIC_RELEASE);
+
+    if (n + 1 - __atomic_load_n(&lb.processed, __ATOMIC_ACQUIRE) >= load_buffer_count)
+    {
+        uint64_t start = __builtin_ia32_rdtsc();
+        lb.stalls++;
+        lb.inline_batches += drain_load_batches(tid);
+        lb.stall_cycles += __builtin_ia32_rdtsc() - start;
+    }
+
+    b = (n + 1) % load_buffer_count;
+    lb.cur = lb.buffers[b];
+    lb.end = lb.cur + load_buffer_bytes;
+}
+
+// Room for one record in the thread's buffer
+static inline char* append_load_record(THREADID tid, uint32_t bytes)
+{
+    load_buffer_t& lb = load_buffers[tid];
+    if (lb.cur + bytes > lb.end)
+        submit_load_buffer(tid);
+    char* rec = lb.cur;
+    lb.cur += bytes;
+    lb.records++;
+    return rec;
+}
+
+// Analyzes everything the thread recorded so far, the partly
+// filled buffer included; needed before its shard is swapped
+static void flush_load_buffer(THREADID tid)
+{
+    load_buffer_t& lb = load_buffers[tid];
+    if (!lb.buffers)
+        return;
+    uint64_t n = lb.submitted;
+    uint32_t b = n % load_buffer_count;
+    if (lb.cur != lb.buffers[b])
+    {
+        lb.used[b] = lb.cur - lb.buffers[b];
+        lb.fill_bytes += lb.used[b];
+        __atomic_store_n(&lb.submitted, n + 1, __ATOMIC_RELEASE);
+        lb.cur = lb.buffers[(n + 1) % load_buffer_count];
+        lb.end = lb.cur + load_buffer_bytes;
+    }
+    lb.inline_batches += drain_load_batches(tid);
+}
+
+// Allocates the ring of a new thread; kept for a recycled thread id
+static void init_load_buffer(THREADID tid)
+{
+    load_buffer_t& lb = load_buffers[tid];
+    if (lb.buffers)
+        return;
+
+    PIN_InitLock(&lb.lock);
+    lb.used = new uint64_t[load_buffer_count]();
+    lb.buffers = new char*[load_buffer_count];
+    for (uint32_t b = 0; b < load_buffer_count; b++)
+        lb.buffers[b] = (char*)aligned_alloc(ARENA_ALIGN, load_buffer_bytes);
+    lb.cur = lb.buffers[0];
+    lb.end = lb.cur + load_buffer_bytes;
+}
+
+//-------------------------------//
+// Worker thread; analyzes the batches of the application
+// threads whose id maps to it, until told to stop and idle.
+//-------------------------------//
+static VOID load_worker(VOID* arg)
+{
+    uint32_t worker = (uint32_t)(uintptr_t)arg;
+    uint32_t idle = 0;
+
+    while (true)
+    {
+        BOOL stopping = load_workers_stop;
+        uint64_t batches = 0;
+        for (uint32_t tid = worker; tid < num_thread_ids; tid += num_load_workers)
+            if (load_buffers[tid].processed != load_buffers[tid].submitted)
+                batches += drain_load_batches(tid);
+        load_worker_batches[worker]._count += batches;
+
+        if (batches)
+            idle = 0;
+        else if (stopping)
+            break;
+        else if (++idle < LOAD_WORKER_SPIN)
+            PIN_Yield();
+        else
+            PIN_Sleep(1);
+    }
+}
+
+static BOOL start_load_workers(uint64_t buffer_bytes, uint32_t buffer_count, uint32_t workers)
+{
+    load_buffer_bytes = buffer_bytes;
+    load_buffer_count = buffer_count;
+    num_load_workers = workers;
+    load_worker_uids.assign(workers, PIN_THREAD_UID());
+    load_worker_batches.assign(workers, CACHELINE_COUNTER());
+
+    for (uint32_t w = 0; w < workers; w++)
+        if (PIN_SpawnInternalThread(load_worker, (VOID*)(uintptr_t)w, 0, &load_worker_uids[w]) == INVALID_THREADID)
+            return FALSE;
+    return TRUE;
+}
+
+// Called before fini, while application threads may still run;
+// those that fill their ring afterwards analyze it themselves
+static VOID stop_load_workers(VOID* v)
+{
+    load_workers_stop = TRUE;
+    for (auto it = load_worker_uids.begin(); it != load_worker_uids.end(); ++it)
+        PIN_WaitForThreadTermination(*it, PIN_INFINITE_TIMEOUT, NULL);
+}
+
+// Analyzes what every thread left in its ring; called at fini
+static void flush_load_buffers()
+{
+    for (uint32_t tid = 0; tid < num_thread_ids; ++tid)
+        flush_load_buffer(tid);
+}
+
+//-------------------------------//
+// Appends the buffer section. Fill is the average fraction of
+// a buffer used when it was handed over; queue depth the
+// average batches still waiting for analysis at that point.
+// Stalls are hand-overs that found every buffer waiting, upon
+// which the application thread analyzed them itself.
+//-------------------------------//
+static void dump_buffer_stats(std::string stats_filename)
+{
+    uint64_t records = 0, batches = 0, fill_bytes = 0, queue_depth = 0,
+             stalls = 0, stall_cycles = 0, inline_batches = 0;
+    for (uint32_t tid = 0; tid < PIN_MAX_THREADS; ++tid)
+    {
+        const load_buffer_t& lb = load_buffers[tid];
+        records += lb.records;
+        batches += lb.submitted;
+        fill_bytes += lb.fill_bytes;
+        queue_depth += lb.queue_depth;
+        stalls += lb.stalls;
+        stall_cycles += lb.stall_cycles;
+        inline_batches += lb.inline_batches;
+    }
+
+    std::ofstream stats;
+    stats.open(stats_filename.c_str(), std::ios::app);
+
+    stats << std::endl;
+    stats << "buffer.bytes " << load_buffer_bytes << std::endl;
+    stats << "buffer.count " << load_buffer_count << std::endl;
+    stats << "buffer.workers " << num_load_workers << std::endl;
+    stats << "buffer.records " << records << std::endl;
+    stats << "buffer.batches " << batches << std::endl;
+    stats << "buffer.avg_fill " << (batches ? (double)fill_bytes / (batches * load_buffer_bytes) : 0.0) << std::endl;
+    stats << "buffer.avg_queue_depth " << (batches ? (double)queue_depth / batches : 0.0) << std::endl;
+    stats << "buffer.stalls " << stalls << std::endl;
+    stats << "buffer.stall_cycles " << stall_cycles << std::endl;
+    stats << "buffer.inline_batches " << inline_batches << std::endl;
+    for (uint32_t w = 0; w < num_load_workers; ++w)
+        stats << "buffer.worker." << w << ".batches " << load_worker_batches[w]._count << std::endl;
+
+    stats.close();
+}
+
+#endif
@@ -0,0 +1,29 @@
+/**********************************************************
+ * CSV fields of Load Inspector outputs
+ * Shared by the tool and the readers in tools/, so every
+ * CSV file quotes its fields the same way.
+ **********************************************************/
+
+#ifndef CSV_H
+#define CSV_H
+
+#include <string>
+
+// A field of the CSV outputs; demangled C++ names hold commas
+// (template and argument lists), so such fields are quoted as
+// in RFC 4180
+static inline std::string csv_field(const std::string& field)
+{
+    if (field.find_first_of(",\"\n") == std::string::npos)
+        return field;
+    std::string quoted = "\"";
+    for (auto it = field.begin(); it != field.end(); ++it)
+    {
+        if (*it == '"')
+            quoted += '"';
+        quoted += *it;
+    }
+    return quoted + "\"";
+}
+
+#endif
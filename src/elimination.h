@@ -0,0 +1,275 @@
+/**********************************************************
+ * Stable-load elimination table model of Load Inspector
+ * Global-stable loads assume every load IP is tracked forever.
+ * With -elim, each thread also drives finite, set-associative
+ * tables of the last address/value of load IPs, one per
+ * configuration, and counts the loads they would eliminate:
+ * a hit whose confidence reached the threshold is eliminated
+ * if its address and value match, else mispredicted.
+ **********************************************************/
+
+#ifndef ELIMINATION_H
+#define ELIMINATION_H
+
+#include <cerrno>
+#include <sstream>
+
+#include "stats.h"
+
+typedef enum
+{
+    ELIM_LRU = 0,
+    ELIM_FIFO,
+    ELIM_RANDOM,
+    NUM_ELIM_POLICIES
+} elim_policy_t;
+
+std::string elim_policy_t2str[] = { "lru", "fifo", "random" };
+
+typedef struct
+{
+    uint32_t entries;
+    uint32_t ways;
+    uint32_t sets;
+    elim_policy_t policy;
+    uint32_t confidence;    // matching repeats before loads are eliminated
+} elim_config_t;
+
+typedef struct
+{
+    uint32_t tag;           // slot + 1, zero if empty
+    uint32_t conf;          // saturates at the confidence threshold
+    uint64_t addr;
+    uint64_t val;           // vector values are folded
+    uint64_t stamp;         // last use with LRU, fill with FIFO
+} elim_entry_t;
+
+typedef struct
+{
+    elim_entry_t* entries = NULL;   // sets * ways, a set's ways adjacent
+    uint64_t clock = 0;
+    uint64_t rng = 0x2545f4914f6cdd1dULL;
+    uint64_t loads[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {};
+    uint64_t eliminated[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {};
+    uint64_t mispredictions[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {};
+    uint64_t misses = 0;
+    uint64_t evictions = 0;
+} elim_table_t;
+
+static std::vector<elim_config_t> elim_configs;    // empty disables the model
+static elim_table_t* elim_tables[PIN_MAX_THREADS];  // elim_configs.size() per thread
+
+// Name of a configuration in the stats, e.g. 1024x4_lru_c2
+static std::string elim_config_name(const elim_config_t& config)
+{
+    std::ostringstream name;
+    name << config.entries << "x" << config.ways << "_" << elim_policy_t2str[config.policy]
+         << "_c" << config.confidence;
+    return name.str();
+}
+
+// Parses a decimal field of a configuration; FALSE unless the
+// whole field is a number that fits
+static BOOL parse_elim_number(const std::string& field, uint32_t* value)
+{
+    if (field.empty() || field.find_first_not_of("0123456789") != std::string::npos)
+        return FALSE;
+    errno = 0;
+    unsigned long long number = strtoull(field.c_str(), NULL, 10);
+    if (errno || number > ~0u)
+        return FALSE;
+    *value = number;
+    return TRUE;
+}
+
+//-------------------------------//
+// Parses "ENTRIES:WAYS:POLICY:CONFIDENCE[,...]" into
+// elim_configs; returns FALSE on a malformed configuration
+//-------------------------------//
+static BOOL parse_elim_configs(const std::string& spec)
+{
+    std::istringstream configs(spec);
+    std::string item;
+    while (std::getline(configs, item, ','))
+    {
+        std::istringstream fields(item);
+        std::string entries, ways, policy, confidence;
+        if (!std::getline(fields, entries, ':') || !std::getline(fields, ways, ':')
+            || !std::getline(fields, policy, ':') || !std::getline(fields, confidence, ':')
+            || !fields.eof())
+            return FALSE;
+
+        elim_config_t config;
+        if (!parse_elim_number(entries, &config.entries) || !parse_elim_number(ways, &config.ways)
+            || !parse_elim_number(confidence, &config.confidence))
+            return FALSE;
+        if (!config.ways || config.entries < config.ways || config.entries % config.ways)
+            return FALSE;
+        config.sets = config.entries / config.ways;
+
+        uint32_t p = 0;
+        while (p < NUM_ELIM_POLICIES && policy != elim_policy_t2str[p])
+            p++;
+        if (p == NUM_ELIM_POLICIES)
+            return FALSE;
+        config.policy = (elim_policy_t)p;
+
+        elim_configs.push_back(config);
+    }
+    return !elim_configs.empty();
+}
+
+// Allocates the tables of a new thread; kept for a recycled thread id
+static void init_elim_tables(THREADID tid)
+{
+    if (elim_tables[tid])
+        return;
+
+    elim_tables[tid] = new elim_table_t[elim_configs.size()];
+    for (uint32_t c = 0; c < elim_configs.size(); c++)
+        elim_tables[tid][c].entries = new elim_entry_t[elim_configs[c].entries]();
+}
+
+// Way to refill in a set with no entry of the slot
+static inline uint32_t elim_victim(const elim_config_t& config, elim_table_t& table, const elim_entry_t* set)
+{
+    uint32_t victim = 0;
+    for (uint32_t way = 0; way < config.ways; way++)
+    {
+        if (!set[way].tag)
+            return way;
+        if (set[way].stamp < set[victim].stamp)
+            victim = way;
+    }
+
+    if (config.policy == ELIM_RANDOM)
+    {
+        table.rng ^= table.rng << 13;
+        table.rng ^= table.rng >> 7;
+        table.rng ^= table.rng << 17;
+        victim = table.rng % config.ways;
+    }
+    table.evictions++;
+    return victim;
+}
+
+// One load of a slot through one table. Sets are indexed by a hash
+// of the slot, so by load IP and, for gathers, by element.
+static inline void elim_access(const elim_config_t& config, elim_table_t& table, uint32_t slot,
+                               uint32_t ltype, uint32_t sizeb, uint64_t ea, uint64_t val)
+{
+    uint32_t hash = (uint32_t)(((uint64_t)(slot + 1) * 0x9e3779b97f4a7c15ULL) >> 32);
+    elim_entry_t* set = &table.entries[(((uint64_t)hash * config.sets) >> 32) * config.ways];
+
+    table.loads[ltype][sizeb]++;
+    table.clock++;
+
+    for (uint32_t way = 0; way < config.ways; way++)
+    {
+        elim_entry_t& e = set[way];
+        if (e.tag != slot + 1)
+            continue;
+
+        BOOL matches = (e.addr == ea && e.val == val);
+        if (e.conf >= config.confidence)
+        {
+            if (matches)
+                table.eliminated[ltype][sizeb]++;
+            else
+                table.mispredictions[ltype][sizeb]++;
+        }
+
+        if (!matches)
+        {
+            e.addr = ea;
+            e.val = val;
+            e.conf = 0;
+        }
+        else if (e.conf < config.confidence)
+            e.conf++;
+
+        if (config.policy == ELIM_LRU)
+            e.stamp = table.clock;
+        return;
+    }
+
+    table.misses++;
+    elim_entry_t& e = set[elim_victim(config, table, set)];
+    e.tag = slot + 1;
+    e.conf = 0;
+    e.addr = ea;
+    e.val = val;
+    e.stamp = table.clock;
+}
+
+// Feeds one load to every configuration of the thread
+static inline void model_elimination(THREADID tid, uint32_t slot, uint32_t ltype, uint32_t sizeb,
+                                     uint64_t ea, uint64_t val)
+{
+    elim_table_t* tables = elim_tables[tid];
+    for (uint32_t c = 0; c < elim_configs.size(); c++)
+        elim_access(elim_configs[c], tables[c], slot, ltype, sizeb, ea, val);
+}
+
+//-------------------------------//
+// Appends the elimination stats of every configuration, summed
+// over the threads. Coverage is the fraction of the modeled
+// loads eliminated; loads of untracked IPs and sizes are not
+// modeled.
+//-------------------------------//
+static void dump_elim_stats(std::string stats_filename)
+{
+    std::ofstream stats;
+    stats.open(stats_filename.c_str(), std::ios::app);
+
+    for (uint32_t c = 0; c < elim_configs.size(); c++)
+    {
+        elim_table_t sum;
+        for (uint32_t tid = 0; tid < PIN_MAX_THREADS; ++tid)
+        {
+            if (!elim_tables[tid])
+                continue;
+            const elim_table_t& table = elim_tables[tid][c];
+            FOREACH_LOAD_TYPE_SIZE({
+                sum.loads[type][size] += table.loads[type][size];
+                sum.eliminated[type][size] += table.eliminated[type][size];
+                sum.mispredictions[type][size] += table.mispredictions[type][size];
+            });
+            sum.misses += table.misses;
+            sum.evictions += table.evictions;
+        }
+
+        uint64_t loads = 0, eliminated = 0, mispredictions = 0;
+        FOREACH_LOAD_TYPE_SIZE({
+            loads += sum.loads[type][size];
+            eliminated += sum.eliminated[type][size];
+            mispredictions += sum.mispredictions[type][size];
+        });
+
+        const std::string prefix = "elim." + elim_config_name(elim_configs[c]);
+        stats << std::endl;
+        stats << prefix << ".loads.total " << loads << std::endl;
+        stats << prefix << ".eliminated_loads.total " << eliminated << std::endl;
+        stats << prefix << ".coverage.total " << (loads ? (double)eliminated / loads : 0.0) << std::endl;
+        stats << prefix << ".mispredictions.total " << mispredictions << std::endl;
+        stats << prefix << ".misses " << sum.misses << std::endl;
+        stats << prefix << ".evictions " << sum.evictions << std::endl;
+        FOREACH_LOAD_TYPE_SIZE({
+            stats << prefix << ".loads." << load_type_t2str[type] << "." << load_size2str[size] << " " << sum.loads[type][size] << std::endl;
+        });
+        FOREACH_LOAD_TYPE_SIZE({
+            stats << prefix << ".eliminated_loads." << load_type_t2str[type] << "." << load_size2str[size] << " " << sum.eliminated[type][size] << std::endl;
+        });
+        FOREACH_LOAD_TYPE_SIZE({
+            stats << prefix << ".coverage." << load_type_t2str[type] << "." << load_size2str[size] << " "
+                  << (sum.loads[type][size] ? (double)sum.eliminated[type][size] / sum.loads[type][size] : 0.0) << std::endl;
+        });
+        FOREACH_LOAD_TYPE_SIZE({
+            stats << prefix << ".mispredictions." << load_type_t2str[type] << "." << load_size2str[size] << " " << sum.mispredictions[type][size] << std::endl;
+        });
+    }
+
+    stats.close();
+}
+
+#endif
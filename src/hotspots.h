@@ -0,0 +1,255 @@
+/**********************************************************
+ * Hotspot attribution of Load Inspector (-hotspots)
+ * Ranks routines and innermost loops by their stable loads.
+ * Every load slot is tagged with its routine when its IP is
+ * instrumented, and loops are the backward branches seen by
+ * Trace(), so the analysis routines do nothing extra: the
+ * per-slot counts are summed per routine and loop at fini.
+ **********************************************************/
+
+#ifndef HOTSPOTS_H
+#define HOTSPOTS_H
+
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+
+#include "stats.h"
+
+typedef struct
+{
+    std::string name;
+    uint64_t address;
+    uint32_t epoch;     // image epoch it was first seen in
+} routine_info_t;
+
+typedef struct
+{
+    uint64_t end;       // one past the farthest backward branch to the head
+    uint32_t routine;
+    uint32_t epoch;     // image epoch it was first seen in
+} loop_info_t;
+
+typedef struct
+{
+    uint64_t loads = 0;
+    uint64_t stable_loads = 0;
+    uint64_t load_ips = 0;
+    uint64_t stable_load_ips = 0;
+} hotspot_counts_t;
+
+static uint32_t hotspot_top = 0; // zero disables
+
+// Grown at instrumentation time, under load_slot_lock or Pin's
+// own instrumentation lock; only read at fini
+static std::vector<routine_info_t> routines(1, routine_info_t{ "[unknown]", 0, 0 }); // by id
+static std::unordered_map<uint64_t, uint32_t> routine_ids; // by routine address
+static std::vector<uint32_t> load_slot_routine; // parallel to load_slot_ip
+static std::map<uint64_t, loop_info_t> loops; // by head address
+
+static uint32_t get_routine_id(RTN rtn)
+{
+    if (!RTN_Valid(rtn))
+        return 0;
+
+    auto it = routine_ids.find(RTN_Address(rtn));
+    if (it != routine_ids.end())
+        return it->second;
+
+    uint32_t id = routines.size();
+    routines.push_back(routine_info_t{ RTN_Name(rtn), RTN_Address(rtn), image_epoch });
+    routine_ids[RTN_Address(rtn)] = id;
+    return id;
+}
+
+// Tags the slots of a load IP with its routine, when they are new;
+// called under load_slot_lock right after get_load_slot
+static void attribute_load_slots(INS ins, uint32_t slot, uint32_t num_slots)
+{
+    if (slot == UNTRACKED_SLOT || slot < load_slot_routine.size())
+        return;
+    load_slot_routine.resize(slot + std::max(num_slots, 1u), get_routine_id(INS_Rtn(ins)));
+}
+
+// Records the loops closed by the backward branches of a trace;
+// called from Trace(), which Pin serializes
+static void note_loops(TRACE trace)
+{
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl))
+    {
+        INS tail = BBL_InsTail(bbl);
+        if (!INS_IsDirectControlFlow(tail) || INS_IsCall(tail))
+            continue;
+
+        uint64_t head = INS_DirectControlFlowTargetAddress(tail);
+        if (head > INS_Address(tail))
+            continue;
+
+        uint64_t end = INS_Address(tail) + INS_Size(tail);
+        auto it = loops.find(head);
+        if (it == loops.end())
+            loops[head] = loop_info_t{ end, get_routine_id(INS_Rtn(tail)), image_epoch };
+        else if (end > it->second.end)
+            it->second.end = end;
+    }
+}
+
+// "image,offset" of an address seen in the given image epoch;
+// expects sorted image ranges
+static std::string hotspot_location(uint64_t address, uint32_t epoch)
+{
+    std::ostringstream location;
+    int32_t image = find_image(address, epoch);
+    location << csv_field(image < 0 ? LOAD_PROFILE_ANON_IMAGE : image_ranges[image].name)
+             << ",0x" << std::hex << (image < 0 ? address : address - image_ranges[image].low);
+    return location.str();
+}
+
+// Writes the top entries by stable loads, then by loads
+static void dump_hotspot_ranking(std::ofstream& report, const std::string& kind,
+                                 const std::vector<hotspot_counts_t>& counts,
+                                 const std::vector<std::string>& names,
+                                 const std::vector<uint64_t>& addresses,
+                                 const std::vector<uint32_t>& epochs)
+{
+    std::vector<uint32_t> ranked;
+    for (uint32_t id = 0; id < counts.size(); ++id)
+        if (counts[id].loads)
+            ranked.push_back(id);
+    std::sort(ranked.begin(), ranked.end(),
+            [&counts](uint32_t a, uint32_t b)
+            {
+                if (counts[a].stable_loads != counts[b].stable_loads)
+                    return counts[a].stable_loads > counts[b].stable_loads;
+                return counts[a].loads > counts[b].loads;
+            });
+    if (ranked.size() > hotspot_top)
+        ranked.resize(hotspot_top);
+
+    for (uint32_t rank = 0; rank < ranked.size(); ++rank)
+    {
+        const hotspot_counts_t& c = counts[ranked[rank]];
+        report << kind
+               << "," << rank + 1
+               << "," << csv_field(names[ranked[rank]])
+               << "," << hotspot_location(addresses[ranked[rank]], epochs[ranked[rank]])
+               << "," << std::dec << c.loads
+               << "," << c.stable_loads
+               << "," << c.load_ips
+               << "," << c.stable_load_ips
+               << "," << std::fixed << std::setprecision(4) << (double)c.stable_loads / c.loads
+               << std::endl;
+    }
+}
+
+//-------------------------------//
+// Writes the ranked routines and innermost loops; must run
+// after dump_stats. A load slot belongs to the smallest loop
+// whose head and backward branch enclose its IP. Loads of IPs
+// refused by -max_table_mb have no slot and are left out.
+//-------------------------------//
+static void dump_hotspots(std::string hotspot_filename)
+{
+    sort_image_ranges();
+
+    std::vector<uint32_t> slots_by_ip;
+    for (uint32_t slot = 0; slot < load_slots.size(); ++slot)
+        if (load_slots[slot].occur)
+            slots_by_ip.push_back(slot);
+    std::sort(slots_by_ip.begin(), slots_by_ip.end(),
+            [](uint32_t a, uint32_t b)
+            {
+                return load_slot_ip[a] < load_slot_ip[b];
+            });
+
+    // larger loops first, so the innermost one is assigned last
+    std::vector<uint64_t> loop_heads;
+    for (auto it = loops.begin(); it != loops.end(); ++it)
+        loop_heads.push_back(it->first);
+    std::sort(loop_heads.begin(), loop_heads.end(),
+            [](uint64_t a, uint64_t b)
+            {
+                return loops[a].end - a > loops[b].end - b;
+            });
+
+    const uint32_t NO_LOOP = ~0u;
+    std::vector<uint32_t> slot_loop(load_slots.size(), NO_LOOP);
+    for (uint32_t loop = 0; loop < loop_heads.size(); ++loop)
+    {
+        uint64_t head = loop_heads[loop], end = loops[head].end;
+        auto it = std::lower_bound(slots_by_ip.begin(), slots_by_ip.end(), head,
+                [](uint32_t slot, uint64_t ip)
+                {
+                    return load_slot_ip[slot] < ip;
+                });
+        for (; it != slots_by_ip.end() && load_slot_ip[*it] < end; ++it)
+            slot_loop[*it] = loop;
+    }
+
+    // the element slots of a multi-reference load share its IP, so
+    // they are adjacent here and count as one load PC, stable if all
+    // of its executed elements are
+    std::vector<hotspot_counts_t> routine_counts(routines.size()), loop_counts(loop_heads.size());
+    for (auto first = slots_by_ip.begin(); first != slots_by_ip.end();)
+    {
+        auto last = first;
+        BOOL stable_ip = TRUE;
+        hotspot_counts_t ip_counts;
+        for (; last != slots_by_ip.end() && load_slot_ip[*last] == load_slot_ip[*first]; ++last)
+        {
+            const load_slot_t& ls = load_slots[*last];
+            BOOL stable = !ls.unstable && ls.occur > 1;
+            ip_counts.loads += ls.occur;
+            if (stable)
+                ip_counts.stable_loads += ls.occur;
+            stable_ip = stable_ip && stable;
+        }
+
+        hotspot_counts_t* counts[2] = {
+            &routine_counts[*first < load_slot_routine.size() ? load_slot_routine[*first] : 0],
+            slot_loop[*first] != NO_LOOP ? &loop_counts[slot_loop[*first]] : NULL
+        };
+        for (uint32_t i = 0; i < 2; ++i)
+        {
+            if (!counts[i])
+                continue;
+            counts[i]->loads += ip_counts.loads;
+            counts[i]->stable_loads += ip_counts.stable_loads;
+            counts[i]->load_ips++;
+            counts[i]->stable_load_ips += stable_ip;
+        }
+        first = last;
+    }
+
+    std::vector<std::string> routine_names, loop_names;
+    std::vector<uint64_t> routine_addresses, loop_addresses;
+    std::vector<uint32_t> routine_epochs, loop_epochs;
+    for (auto it = routines.begin(); it != routines.end(); ++it)
+    {
+        routine_names.push_back(it->name);
+        routine_addresses.push_back(it->address);
+        routine_epochs.push_back(it->epoch);
+    }
+    for (auto it = loop_heads.begin(); it != loop_heads.end(); ++it)
+    {
+        const routine_info_t& rtn = routines[loops[*it].routine];
+        std::ostringstream name;
+        if (loops[*it].routine)
+            name << rtn.name << "+0x" << std::hex << *it - rtn.address;
+        else
+            name << "0x" << std::hex << *it;
+        loop_names.push_back(name.str());
+        loop_addresses.push_back(*it);
+        loop_epochs.push_back(loops[*it].epoch);
+    }
+
+    std::ofstream report;
+    report.open(hotspot_filename.c_str());
+    report << "kind,rank,name,image,offset,loads,stable_loads,load_ips,stable_load_ips,stable_fraction" << std::endl;
+    dump_hotspot_ranking(report, "routine", routine_counts, routine_names, routine_addresses, routine_epochs);
+    dump_hotspot_ranking(report, "loop", loop_counts, loop_names, loop_addresses, loop_epochs);
+    report.close();
+}
+
+#endif
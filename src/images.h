@@ -0,0 +1,93 @@
+/**********************************************************
+ * Image index of Load Inspector
+ * Address ranges of every image loaded during the run,
+ * to express load IPs relative to their image at fini.
+ * An image unloaded and another mapped over its range later
+ * both stay; each range is stamped with the image epochs it
+ * was live in, and IPs resolve against the range that was
+ * live when they were instrumented.
+ **********************************************************/
+
+#ifndef IMAGES_H
+#define IMAGES_H
+
+#include <algorithm>
+#include <string>
+#include <vector>
+
+typedef struct
+{
+    std::string name;
+    uint64_t low;       // first byte
+    uint64_t high;      // one past the last byte
+    uint32_t loaded;    // first epoch the image was live in
+    uint32_t unloaded;  // first epoch after it, or IMAGE_LIVE
+    uint64_t max_high;  // highest high of this and the ranges sorted before it
+} image_range_t;
+
+const uint32_t IMAGE_LIVE = ~0u;
+
+// Bumped at every image load and unload, by the IMG callbacks,
+// which Pin serializes with instrumentation
+static volatile uint32_t image_epoch = 0;
+
+// Appended from the IMG load callback; sorted by
+// sort_image_ranges at fini
+static std::vector<image_range_t> image_ranges;
+
+static void add_image_range(const std::string& name, uint64_t low, uint64_t high)
+{
+    image_range_t range;
+    range.name = name;
+    range.low = low;
+    range.high = high;
+    range.loaded = ++image_epoch;
+    range.unloaded = IMAGE_LIVE;
+    range.max_high = high;
+    image_ranges.push_back(range);
+}
+
+static void remove_image_range(uint64_t low)
+{
+    uint32_t epoch = ++image_epoch;
+    for (auto it = image_ranges.begin(); it != image_ranges.end(); ++it)
+        if (it->low == low && it->unloaded == IMAGE_LIVE)
+            it->unloaded = epoch;
+}
+
+static void sort_image_ranges()
+{
+    std::sort(image_ranges.begin(), image_ranges.end(),
+            [](const image_range_t &a, const image_range_t &b)
+            {
+                return a.low != b.low ? a.low < b.low : a.loaded < b.loaded;
+            });
+    uint64_t max_high = 0;
+    for (auto it = image_ranges.begin(); it != image_ranges.end(); ++it)
+    {
+        max_high = std::max(max_high, it->high);
+        it->max_high = max_high;
+    }
+}
+
+// Returns the index of the image containing ip in the given epoch,
+// or -1. Expects sorted ranges.
+static int32_t find_image(uint64_t ip, uint32_t epoch)
+{
+    auto it = std::upper_bound(image_ranges.begin(), image_ranges.end(), ip,
+            [](uint64_t key, const image_range_t &range)
+            {
+                return key < range.low;
+            });
+    while (it != image_ranges.begin())
+    {
+        --it;
+        if (it->max_high <= ip)
+            break;
+        if (ip < it->high && it->loaded <= epoch && epoch < it->unloaded)
+            return (int32_t)(it - image_ranges.begin());
+    }
+    return -1;
+}
+
+#endif
@@ -9,7 +9,7 @@
 
 #include <iostream>
 #include <string>
-#include <math.h>
+#include <unordered_map>
 
 #include "pin.H"
 extern "C"
@@ -29,6 +29,14 @@ using namespace INSTLIB;
 using namespace CONTROLLER;
 
 #include "stats.h" // defines all stats
+#include "interval.h"
+#include "sampling.h"
+#include "regions.h"
+#include "locality.h"
+#include "buffered.h"
+#include "hotspots.h"
+#include "elimination.h"
+#include "live.h"
 
 // #define LOAD_DEBUG 1
 
@@ -44,10 +52,94 @@ static KNOB<bool> KnobDumpStableLoads(KNOB_MODE_WRITEONCE, "pintool", "dsl", "0"
 static KNOB<std::string> KnobStableLoadsFilename(KNOB_MODE_WRITEONCE, "pintool", "slf", "stable-load.ips.txt",
                                       "specify stable load output filename");
 
+static KNOB<std::string> KnobProfileFilename(KNOB_MODE_WRITEONCE, "pintool", "binf", "",
+                                      "specify binary per-IP load profile filename (empty disables)");
+
+static KNOB<std::string> KnobRegionFilename(KNOB_MODE_WRITEONCE, "pintool", "regionf", "stable-load.regions.txt",
+                                      "specify per-PC-region stats output filename (with -pcregions:in)");
+
+static KNOB<bool> KnobExitOnStop(KNOB_MODE_WRITEONCE, "pintool", "exit_on_stop", "0",
+                                "Exit the application at the end of the ROI, e.g. for one slice of a sliced run");
+
+static KNOB<bool> KnobPruneUnstable(KNOB_MODE_WRITEONCE, "pintool", "prune_unstable", "1",
+                                "Drop the code of load IPs that turn unstable, to re-instrument them count-only");
+
+static KNOB<UINT32> KnobPruneBatch(KNOB_MODE_WRITEONCE, "pintool", "prune_batch", "16",
+                                "Number of unstable load IPs batched per code cache invalidation round");
+
+static KNOB<UINT64> KnobInterval(KNOB_MODE_WRITEONCE, "pintool", "interval", "0",
+                                "Write a snapshot of load stats every given instructions (0 disables)");
+
+static KNOB<std::string> KnobIntervalFilename(KNOB_MODE_WRITEONCE, "pintool", "intervalf", "stable-load.intervals.txt",
+                                      "specify interval snapshot output filename");
+
+static KNOB<UINT64> KnobSampleWindow(KNOB_MODE_WRITEONCE, "pintool", "sample_window", "0",
+                                "Only instrument loads during windows of the given instructions (0 disables)");
+
+static KNOB<UINT64> KnobSamplePeriod(KNOB_MODE_WRITEONCE, "pintool", "sample_period", "0",
+                                "Start a sampling window every given instructions");
+
+static KNOB<bool> KnobLocality(KNOB_MODE_WRITEONCE, "pintool", "locality", "0",
+                                "Classify load IPs by address/value locality and last-value/stride predictability");
+
+static KNOB<UINT32> KnobLocalityThreshold(KNOB_MODE_WRITEONCE, "pintool", "locality_threshold", "90",
+                                "Hit rate in percent for a load IP to count as last-value or stride predictable");
+
+static KNOB<UINT64> KnobMaxTableMB(KNOB_MODE_WRITEONCE, "pintool", "max_table_mb", "0",
+                                "Cap the load tables at the given MB; new load IPs beyond it are only counted (0 disables)");
+
+static KNOB<bool> KnobOverhead(KNOB_MODE_WRITEONCE, "pintool", "overhead", "0",
+                                "Report the tool's own overhead: analysis calls and cycles, code cache and ROI wall time");
+
+static KNOB<bool> KnobBuffered(KNOB_MODE_WRITEONCE, "pintool", "buffered", "0",
+                                "Record loads into per-thread buffers, analyzed by internal worker threads");
+
+static KNOB<UINT32> KnobBufferKB(KNOB_MODE_WRITEONCE, "pintool", "buffer_kb", "256",
+                                "Size in KB of each load buffer (with -buffered)");
+
+static KNOB<UINT32> KnobBufferCount(KNOB_MODE_WRITEONCE, "pintool", "buffer_count", "4",
+                                "Load buffers per thread, in flight at once (with -buffered)");
+
+static KNOB<UINT32> KnobAnalysisThreads(KNOB_MODE_WRITEONCE, "pintool", "analysis_threads", "1",
+                                "Internal threads analyzing the load buffers (with -buffered)");
+
+static KNOB<UINT32> KnobHotspots(KNOB_MODE_WRITEONCE, "pintool", "hotspots", "0",
+                                "Rank the given number of top routines and loops by stable loads (0 disables)");
+
+static KNOB<std::string> KnobHotspotFilename(KNOB_MODE_WRITEONCE, "pintool", "hotspotf", "stable-load.hotspots.txt",
+                                      "specify routine/loop hotspot report filename (with -hotspots)");
+
+static KNOB<std::string> KnobElim(KNOB_MODE_WRITEONCE, "pintool", "elim", "",
+                                "Model stable-load elimination tables, as ENTRIES:WAYS:POLICY:CONFIDENCE[,...] with POLICY lru, fifo or random");
+
+static KNOB<std::string> KnobLiveFilename(KNOB_MODE_WRITEONCE, "pintool", "live_file", "",
+                                "Keep the live counters in this file, mapped shared and updated every -live_ms");
+
+static KNOB<UINT32> KnobLiveMs(KNOB_MODE_WRITEONCE, "pintool", "live_ms", "1000",
+                                "Period of the live counter updates and of the -snapshot_trigger checks, in ms");
+
+static KNOB<UINT32> KnobSnapshotSignal(KNOB_MODE_WRITEONCE, "pintool", "snapshot_signal", "0",
+                                "Write a stats snapshot whenever the target gets this signal (0 disables)");
+
+static KNOB<std::string> KnobSnapshotTrigger(KNOB_MODE_WRITEONCE, "pintool", "snapshot_trigger", "",
+                                "Write a stats snapshot whenever this file appears, then delete it");
+
+static KNOB<std::string> KnobSnapshotPrefix(KNOB_MODE_WRITEONCE, "pintool", "snapshotf", "stable-load.snapshot",
+                                      "specify the prefix of the stats snapshot files, written as <prefix>.<id>.txt");
+
+static KNOB<bool> KnobTrackStores(KNOB_MODE_WRITEONCE, "pintool", "track_stores", "0",
+                                "Classify stable loads by the stores that hit their address");
+
 static PIN_LOCK output_lock;
 
+static std::vector<ADDRINT> prune_pending;
+
 static BOOL inside_roi = FALSE;
 
+// Whether known unstable slots may be instrumented count-only; not when
+// a slot's stability is per region, or every load is needed for locality
+static BOOL prune_slots = TRUE;
+
 // Contains knobs and instrumentation to recognize start/stop points
 static CONTROLLER::CONTROL_MANAGER* sde_control = SDE_CONTROLLER::sde_controller_get();
 
@@ -56,17 +148,41 @@ KNOB_COMMENT pcregion_knob_family("pintool:pcregions_control", "PC regions contr
 CONTROL_ARGS args("", "pintool:pcregions_control");
 CONTROL_PCREGIONS pcregions(args, sde_control);
 
+// Every ROI transition flushes the whole code cache, which also
+// re-instruments the IPs still waiting for a batch
+static VOID drop_pending_prunes()
+{
+    PIN_GetLock(&load_slot_lock, PIN_ThreadId() + 1);
+    prune_pending.clear();
+    PIN_ReleaseLock(&load_slot_lock);
+}
+
+// Load analysis is only inserted while inside the ROI, so every ROI
+// transition flushes the code cache to re-instrument with/without it.
+// With PC regions, the thread also moves into the region's stats.
 VOID Handler(EVENT_TYPE ev, VOID* v, CONTEXT* ctxt, VOID* ip, THREADID tid, BOOL bcast)
 {
     PIN_GetLock(&output_lock, tid + 1);
 
     string eventstr;
+    BOOL roi_changed = FALSE;
 
     switch (ev)
     {
         case EVENT_START:
             eventstr = "Sim-Start";
+            roi_changed = !inside_roi;
             inside_roi = TRUE;
+            if (regions_enabled && load_buffer_bytes)
+                flush_load_buffer(tid);
+            if (regions_enabled && pcregions.LastTriggeredRegion(tid))
+            {
+                PCREGION* region = pcregions.LastTriggeredRegion(tid);
+                enter_region(tid, region->GetRegionId(),
+                             region->GetWeightTimesHundredThousand() / 100000.0,
+                             region->GetRegionMultiplier());
+                eventstr += " region " + decstr(region->GetRegionId());
+            }
             break;
 
         case EVENT_WARMUP_START:
@@ -75,7 +191,14 @@ VOID Handler(EVENT_TYPE ev, VOID* v, CONTEXT* ctxt, VOID* ip, THREADID tid, BOOL
 
         case EVENT_STOP:
             eventstr = "Sim-End";
+            roi_changed = inside_roi;
             inside_roi = FALSE;
+            if (regions_enabled)
+            {
+                if (load_buffer_bytes)
+                    flush_load_buffer(tid);
+                leave_region(tid);
+            }
             break;
 
         case EVENT_WARMUP_STOP:
@@ -94,9 +217,22 @@ VOID Handler(EVENT_TYPE ev, VOID* v, CONTEXT* ctxt, VOID* ip, THREADID tid, BOOL
 
     std::cerr << eventstr;
     std::cerr << " tid " << dec << tid << " pc " << hex << ip;
-    std::cerr << " global_ins_count " << dec << global_ins_counter._count << endl;
+    std::cerr << " global_ins_count " << dec << sum_thread_counters(thread_ins_counter) << endl;
+
+    if (roi_changed)
+        overhead_roi_transition(inside_roi);
 
     PIN_ReleaseLock(&output_lock);
+
+    if (roi_changed)
+    {
+        drop_pending_prunes();
+        PIN_RemoveInstrumentation();
+    }
+
+    // Nothing is profiled past the ROI; fini still runs
+    if (ev == EVENT_STOP && KnobExitOnStop)
+        PIN_ExitApplication(0);
 }
 
 static inline BOOL mem_op_is_rip(xed_decoded_inst_t *xedd, unsigned int mem_idx)
@@ -117,157 +253,1025 @@ static inline load_type_t get_load_type(BOOL is_rip, BOOL is_stack)
 
 static inline uint32_t get_size_bucket(UINT32 size)
 {
-    return (size > 64 || (size & (size-1))) ? 7 : (uint32_t)std::log2(size);
+    return (size == 0 || size > 64 || (size & (size-1))) ? 7 : (uint32_t)__builtin_ctz(size);
 }
 
-static VOID capture_load(ADDRINT ip, ADDRINT ea, UINT32 size, BOOL is_rip, BOOL is_stack)
+// Marks a slot as known unstable for all threads, so newly instrumented
+// code only counts it. With -prune_unstable, once enough of them have
+// piled up, their traces are dropped from the code cache so existing
+// code gets re-instrumented too.
+// A slot is pruned for the reason SLOT_UNTRACKED when a thread
+// could not track it under -max_table_mb.
+// Without prune_slots, slots are marked but never instrumented count-only.
+// With -buffered, slots are marked by the workers, which must not
+// invalidate code, so existing code is never re-instrumented.
+static VOID prune_load_slot(THREADID tid, UINT32 slot, uint8_t reason = SLOT_PRUNED)
 {
-    if (!inside_roi)
-        return;
+    std::vector<ADDRINT> ips;
+    BOOL first = FALSE;
+
+    PIN_GetLock(&load_slot_lock, tid + 1);
+    if (load_slot_pruned[slot])
+        load_slot_pruned[slot] |= reason;
+    else
+    {
+        first = TRUE;
+        load_slot_pruned[slot] = reason;
+        pruned_load_ips++;
+        if (KnobPruneUnstable && prune_slots && !load_buffer_bytes)
+        {
+            prune_pending.push_back(load_slot_ip[slot]);
+            if (prune_pending.size() >= KnobPruneBatch.Value())
+            {
+                ips.swap(prune_pending);
+                prune_invalidations++;
+                prune_invalidated_ips += ips.size();
+            }
+        }
+    }
+    PIN_ReleaseLock(&load_slot_lock);
+
+    if (first && KnobTrackStores)
+        untrack_store_candidate(tid, slot);
+
+    // Pin takes the VM lock to invalidate, and Instruction() takes
+    // load_slot_lock under it, so never hold ours across the call
+    for (auto it = ips.begin(); it != ips.end(); ++it)
+        PIN_RemoveInstrumentationInRange(*it, *it);
+}
+
+// Counts a slot's first repeat once, whichever thread sees it; not
+// if another thread already found the slot unstable
+static VOID note_repeated_slot(THREADID tid, UINT32 slot)
+{
+    PIN_GetLock(&load_slot_lock, tid + 1);
+    if (!load_slot_repeated[slot] && !load_slot_pruned[slot])
+    {
+        load_slot_repeated[slot] = 1;
+        repeated_load_ips++;
+    }
+    PIN_ReleaseLock(&load_slot_lock);
+}
+
+// Value width of each scalar size bucket
+template <uint32_t SIZEB> struct load_value_type;
+template <> struct load_value_type<0> { typedef uint8_t type; };
+template <> struct load_value_type<1> { typedef uint16_t type; };
+template <> struct load_value_type<2> { typedef uint32_t type; };
+template <> struct load_value_type<3> { typedef uint64_t type; };
+
+static inline VOID init_load_slot(thread_stats_t* ts, load_slot_t& ls, load_type_t ltype, uint32_t sizeb,
+                                  ADDRINT ea, uint64_t load_value)
+{
+    ls.window = ts->sample_window;
+    ls.load_type = ltype;
+    ls.addr = ea;
+    ls.val = load_value;
+    ls.sizeb = sizeb;
+    ls.occur = 1;
+}
 
-    load_type_t ltype = get_load_type(is_rip, is_stack);
-    uint32_t sizeb = get_size_bucket(size);
+// Updates a slot with whether a load matched the addr/value first observed
+static inline VOID track_load(THREADID tid, UINT32 slot, load_slot_t& ls, BOOL matches)
+{
+    // if either the addr or value mismatches,
+    // blacklist the load slot to be unstable
+    if (!matches)
+    {
+        ls.unstable = 1;
+        ls.occur++;
+        prune_load_slot(tid, slot);
+    }
+    else
+    {
+        thread_stats_t* ts = thread_stats[tid];
+        if (++ls.occur == 2)
+            note_repeated_slot(tid, slot);
+        ls.multi_window |= (ls.window != ts->sample_window);
+    }
+}
 
-    load_count[ltype][sizeb]++;
+// A thread whose shard may not grow under -max_table_mb does not
+// track the load, and the slot can then never be found stable.
+// The slots a thread already pruned are remembered in its shard,
+// so their later loads do not take load_slot_lock; load_slot_pruned
+// itself may be reallocated by get_load_slot at any time.
+static VOID untrack_thread_load(THREADID tid, thread_stats_t* ts, UINT32 slot)
+{
+    ts->untracked_slot_loads++;
 
-    /* Currently only supports analysis on non-vector loads. 
-     * Can be easily extended for vector loads 
-     * by changing the the data type of load_value.
-    */
-    if (size > 8)
+    uint32_t& memo = ts->untracked_memo[slot % UNTRACKED_MEMO];
+    if (memo == slot + 1)
         return;
+    memo = slot + 1;
+    prune_load_slot(tid, slot, SLOT_UNTRACKED);
+}
 
-    uint64_t load_value = 0;
-    PIN_SafeCopy((void *)&load_value, (void *)(ea), size);
+// Slots only ever counted are never checked for stability
+static inline VOID count_load_slot(thread_stats_t* ts, UINT32 slot, uint32_t ltype, uint32_t sizeb)
+{
+    load_slot_t* pls = thread_load_slot(ts, slot);
+    if (!pls)
+    {
+        ts->untracked_slot_loads++;
+        return;
+    }
+    load_slot_t& ls = *pls;
+    if (!ls.occur)
+    {
+        ls.load_type = ltype;
+        ls.sizeb = sizeb;
+        ls.unstable = 1;
+    }
+    ls.occur++;
+}
 
-    // if already known to be unstable, nothing to do
-    if (load_ip_known_unstable.find(ip) != load_ip_known_unstable.end())
+// Checks a scalar load of a slot not known unstable against the
+// addr/value first observed. The LOCALITY variants (-locality) also
+// track the value locality of every execution, and the ELIM ones
+// (-elim) feed it to the elimination tables, so they see the loads
+// of unstable slots too.
+template <load_type_t LTYPE, uint32_t SIZEB, bool LOCALITY, bool ELIM>
+static inline VOID analyze_load(THREADID tid, thread_stats_t* ts, UINT32 slot, load_slot_t& ls,
+                                ADDRINT ea, typename load_value_type<SIZEB>::type load_value)
+{
+    if (LOCALITY)
+        track_locality(thread_locality(ts, slot), !ls.occur, ea, load_value);
+    if (ELIM)
+        model_elimination(tid, slot, LTYPE, SIZEB, ea, load_value);
+    if ((LOCALITY || ELIM) && ls.unstable)
+    {
+        ls.occur++;
         return;
+    }
 
-    // otherwise, check the load addr/value
-    auto it = load_addr_val_map.find(ip);
-    if (it != load_addr_val_map.end())
+    // a slot first seen with another size holds no comparable value
+    // (see analyze_vector_load)
+    if (ls.occur)
+        track_load(tid, slot, ls, ls.sizeb == SIZEB && ls.addr == ea && ls.val == load_value);
+    else
     {
-        // if either the addr or value mismatches,
-        // blacklist the load IP to be unstable
-        if (it->second.addr != ea || it->second.val != load_value)
-        {
-            load_ip_known_unstable.insert(it->first);
-            load_addr_val_map.erase(it);
-        }
-        else
+        init_load_slot(ts, ls, LTYPE, SIZEB, ea, load_value);
+        if (KnobTrackStores)
+            track_store_candidate(tid, slot, ea, sizeof(load_value), &load_value);
+    }
+}
+
+// Vector loads keep their value in the thread's side pool. The compare
+// is a branch-free XOR/OR reduction over a fixed number of words,
+// which the compiler turns into SIMD compares.
+template <load_type_t LTYPE, uint32_t SIZEB, bool LOCALITY, bool ELIM>
+static inline VOID analyze_vector_load(THREADID tid, thread_stats_t* ts, UINT32 slot, load_slot_t& ls,
+                                       ADDRINT ea, const uint64_t* load_value)
+{
+    const uint32_t NWORDS = (1 << SIZEB) / sizeof(uint64_t);
+
+    if (LOCALITY || ELIM)
+    {
+        uint64_t fold = locality_fold(load_value, NWORDS);
+        if (LOCALITY)
+            track_locality(thread_locality(ts, slot), !ls.occur, ea, fold);
+        if (ELIM)
+            model_elimination(tid, slot, LTYPE, SIZEB, ea, fold);
+        if (ls.unstable)
         {
-            it->second.occur++;
+            ls.occur++;
+            return;
         }
     }
+
+    // An IP may be reused by code loading another size: JIT-ed or
+    // reloaded code, or a tile load whose rows changed. The slot's
+    // val is then no index into the pool, and the load is unstable.
+    if (ls.occur && ls.sizeb != SIZEB)
+        track_load(tid, slot, ls, FALSE);
+    else if (ls.occur)
+    {
+        const uint64_t* old_value = ts->vector_values[ls.val].w;
+        uint64_t diff = ls.addr ^ ea;
+        for (uint32_t i = 0; i < NWORDS; i++)
+            diff |= old_value[i] ^ load_value[i];
+        track_load(tid, slot, ls, diff == 0);
+    }
     else
     {
-        load_attr_t la;
-        la.load_type = ltype;
-        la.addr = ea;
-        la.val = load_value;
-        la.sizeb = sizeb;
-        la.occur = 1;
-        load_addr_val_map.insert(std::pair<uint64_t, load_attr_t>(ip, la));
+        vector_value_t vval = {};
+        memcpy(vval.w, load_value, NWORDS * sizeof(uint64_t));
+        ts->vector_values.push_back(vval);
+        init_load_slot(ts, ls, LTYPE, SIZEB, ea, ts->vector_values.size() - 1);
+        if (KnobTrackStores)
+            track_store_candidate(tid, slot, ea, NWORDS * sizeof(uint64_t), load_value);
+    }
+}
+
+/* Load type and size bucket are known when a load is instrumented,
+ * so each combination gets its own analysis routine with the
+ * classification and the value width folded in at compile time.
+ * The OVERHEAD variants (-overhead) also profile themselves.
+ */
+template <load_type_t LTYPE, uint32_t SIZEB, bool OVERHEAD>
+static VOID PIN_FAST_ANALYSIS_CALL count_load(THREADID tid, UINT32 slot)
+{
+    thread_stats_t* ts = thread_stats[tid];
+    overhead_timer<OVERHEAD> timer(ts->overhead, OH_COUNT_LOAD);
+    ts->load_count[LTYPE][SIZEB]++;
+    count_load_slot(ts, slot, LTYPE, SIZEB);
+}
+
+// Load IPs refused by -max_table_mb have no slot and are only counted
+template <load_type_t LTYPE, uint32_t SIZEB, bool OVERHEAD>
+static VOID PIN_FAST_ANALYSIS_CALL count_untracked_load(THREADID tid)
+{
+    thread_stats_t* ts = thread_stats[tid];
+    overhead_timer<OVERHEAD> timer(ts->overhead, OH_COUNT_UNTRACKED_LOAD);
+    ts->load_count[LTYPE][SIZEB]++;
+    ts->untracked_loads++;
+}
+
+template <load_type_t LTYPE, uint32_t SIZEB, bool LOCALITY, bool ELIM, bool OVERHEAD>
+static VOID PIN_FAST_ANALYSIS_CALL capture_load(THREADID tid, UINT32 slot, ADDRINT ea)
+{
+    thread_stats_t* ts = thread_stats[tid];
+    overhead_timer<OVERHEAD> timer(ts->overhead, OH_CAPTURE_LOAD);
+    ts->load_count[LTYPE][SIZEB]++;
+
+    load_slot_t* pls = thread_load_slot(ts, slot);
+    if (!pls)
+    {
+        untrack_thread_load(tid, ts, slot);
+        return;
+    }
+    load_slot_t& ls = *pls;
+
+    // if already known to be unstable, only count it
+    if (!LOCALITY && !ELIM && ls.unstable)
+    {
+        ls.occur++;
+        return;
     }
 
+    typename load_value_type<SIZEB>::type load_value = 0;
+    {
+        overhead_timer<OVERHEAD> copy_timer(ts->overhead, OH_SAFECOPY);
+        PIN_SafeCopy((void *)&load_value, (void *)(ea), sizeof(load_value));
+    }
+
+    analyze_load<LTYPE, SIZEB, LOCALITY, ELIM>(tid, ts, slot, ls, ea, load_value);
+
 #ifdef LOAD_DEBUG
-    std::cout << std::hex << "0x" << ip
-              << ": S=" << std::dec << size << "B"
+    std::cout << std::hex << "0x" << load_slot_ip[slot]
+              << ": S=" << std::dec << sizeof(load_value) << "B"
               << ", Addr=0x" << std::hex << ea
-              << ", Val=0x" << std::hex << load_value
+              << ", Val=0x" << std::hex << (uint64_t)load_value
               << std::endl;
 #endif
 }
 
-static VOID mem_agen(THREADID tid, ADDRINT ip, xed_decoded_inst_t *xedd)
+template <load_type_t LTYPE, uint32_t SIZEB, bool LOCALITY, bool ELIM, bool OVERHEAD>
+static VOID PIN_FAST_ANALYSIS_CALL capture_vector_load(THREADID tid, UINT32 slot, ADDRINT ea)
 {
-    if (!inside_roi)
+    const uint32_t NWORDS = (1 << SIZEB) / sizeof(uint64_t);
+
+    thread_stats_t* ts = thread_stats[tid];
+    overhead_timer<OVERHEAD> timer(ts->overhead, OH_CAPTURE_VECTOR_LOAD);
+    ts->load_count[LTYPE][SIZEB]++;
+
+    load_slot_t* pls = thread_load_slot(ts, slot);
+    if (!pls)
+    {
+        untrack_thread_load(tid, ts, slot);
         return;
+    }
+    load_slot_t& ls = *pls;
 
-    unsigned int i, nrefs = 0;
-    if (!sde_agen_init(tid, &nrefs))
+    // if already known to be unstable, only count it
+    if (!LOCALITY && !ELIM && ls.unstable)
+    {
+        ls.occur++;
+        return;
+    }
+
+    uint64_t load_value[NWORDS];
+    {
+        overhead_timer<OVERHEAD> copy_timer(ts->overhead, OH_SAFECOPY);
+        PIN_SafeCopy((void *)load_value, (void *)(ea), sizeof(load_value));
+    }
+
+    analyze_vector_load<LTYPE, SIZEB, LOCALITY, ELIM>(tid, ts, slot, ls, ea, load_value);
+}
+
+/* With -buffered, the routines plugged into the instrumentation
+ * only append a record of the load to the thread's buffer, and
+ * the workers replay them into the thread's shard (see buffered.h).
+ * The load histogram is still counted on the application thread.
+ */
+template <load_type_t LTYPE, uint32_t SIZEB, bool OVERHEAD>
+static VOID PIN_FAST_ANALYSIS_CALL buffer_count_load(THREADID tid, UINT32 slot)
+{
+    thread_stats_t* ts = thread_stats[tid];
+    overhead_timer<OVERHEAD> timer(ts->overhead, OH_COUNT_LOAD);
+    ts->load_count[LTYPE][SIZEB]++;
+
+    load_record_t* rec = (load_record_t*)append_load_record(tid, load_record_bytes(SIZEB, TRUE));
+    rec->slot = slot;
+    rec->load_type = LTYPE;
+    rec->sizeb = SIZEB;
+    rec->count_only = 1;
+}
+
+// Whether a slot is unstable is only known to the workers,
+// so the value is copied for every load
+template <load_type_t LTYPE, uint32_t SIZEB, bool OVERHEAD>
+static VOID PIN_FAST_ANALYSIS_CALL buffer_load(THREADID tid, UINT32 slot, ADDRINT ea)
+{
+    thread_stats_t* ts = thread_stats[tid];
+    overhead_timer<OVERHEAD> timer(ts->overhead, SIZEB < NUM_SCALAR_LOAD_SIZES ? OH_CAPTURE_LOAD : OH_CAPTURE_VECTOR_LOAD);
+    ts->load_count[LTYPE][SIZEB]++;
+
+    load_record_t* rec = (load_record_t*)append_load_record(tid, load_record_bytes(SIZEB, FALSE));
+    rec->slot = slot;
+    rec->load_type = LTYPE;
+    rec->sizeb = SIZEB;
+    rec->count_only = 0;
+
+    uint64_t* words = load_record_words(rec);
+    words[0] = ea;
+    words[1] = 0;
+    {
+        overhead_timer<OVERHEAD> copy_timer(ts->overhead, OH_SAFECOPY);
+        PIN_SafeCopy((void *)&words[1], (void *)(ea), 1 << SIZEB);
+    }
+}
+
+template <load_type_t LTYPE, uint32_t SIZEB, bool LOCALITY, bool ELIM>
+static VOID replay_load(THREADID tid, thread_stats_t* ts, const load_record_t* rec)
+{
+    load_slot_t* pls = thread_load_slot(ts, rec->slot);
+    if (!pls)
+    {
+        untrack_thread_load(tid, ts, rec->slot);
+        return;
+    }
+    load_slot_t& ls = *pls;
+    if (!LOCALITY && !ELIM && ls.unstable)
+    {
+        ls.occur++;
         return;
+    }
+
+    const uint64_t* words = load_record_words(rec);
+    analyze_load<LTYPE, SIZEB, LOCALITY, ELIM>(tid, ts, rec->slot, ls, words[0],
+                                         (typename load_value_type<SIZEB>::type)words[1]);
+}
+
+template <load_type_t LTYPE, uint32_t SIZEB, bool LOCALITY, bool ELIM>
+static VOID replay_vector_load(THREADID tid, thread_stats_t* ts, const load_record_t* rec)
+{
+    load_slot_t* pls = thread_load_slot(ts, rec->slot);
+    if (!pls)
+    {
+        untrack_thread_load(tid, ts, rec->slot);
+        return;
+    }
+    load_slot_t& ls = *pls;
+    if (!LOCALITY && !ELIM && ls.unstable)
+    {
+        ls.occur++;
+        return;
+    }
+
+    const uint64_t* words = load_record_words(rec);
+    analyze_vector_load<LTYPE, SIZEB, LOCALITY, ELIM>(tid, ts, rec->slot, ls, words[0], &words[1]);
+}
+
+typedef VOID (PIN_FAST_ANALYSIS_CALL *count_load_fn_t)(THREADID, UINT32);
+typedef VOID (PIN_FAST_ANALYSIS_CALL *capture_load_fn_t)(THREADID, UINT32, ADDRINT);
+typedef VOID (PIN_FAST_ANALYSIS_CALL *count_untracked_fn_t)(THREADID);
+typedef VOID (*replay_load_fn_t)(THREADID, thread_stats_t*, const load_record_t*);
+
+#define COUNT_LOAD_FNS(t, o)                                             \
+    { count_load<t, 0, o>, count_load<t, 1, o>, count_load<t, 2, o>, count_load<t, 3, o>, \
+      count_load<t, 4, o>, count_load<t, 5, o>, count_load<t, 6, o>, count_load<t, 7, o> }
+#define COUNT_UNTRACKED_FNS(t, o)                                        \
+    { count_untracked_load<t, 0, o>, count_untracked_load<t, 1, o>, count_untracked_load<t, 2, o>, \
+      count_untracked_load<t, 3, o>, count_untracked_load<t, 4, o>, count_untracked_load<t, 5, o>, \
+      count_untracked_load<t, 6, o>, count_untracked_load<t, 7, o> }
+#define CAPTURE_LOAD_FNS(t, l, e, o)                                     \
+    { capture_load<t, 0, l, e, o>, capture_load<t, 1, l, e, o>, capture_load<t, 2, l, e, o>, \
+      capture_load<t, 3, l, e, o>, capture_vector_load<t, 4, l, e, o>, capture_vector_load<t, 5, l, e, o>, \
+      capture_vector_load<t, 6, l, e, o> }
+#define CAPTURE_LOAD_TYPE_FNS(l, e, o)                                   \
+    { CAPTURE_LOAD_FNS(RIP_LOAD, l, e, o), CAPTURE_LOAD_FNS(STACK_LOAD, l, e, o), CAPTURE_LOAD_FNS(REG_LOAD, l, e, o), \
+      CAPTURE_LOAD_FNS(GATHER_LOAD, l, e, o) }
+#define BUFFER_COUNT_LOAD_FNS(t, o)                                      \
+    { buffer_count_load<t, 0, o>, buffer_count_load<t, 1, o>, buffer_count_load<t, 2, o>, \
+      buffer_count_load<t, 3, o>, buffer_count_load<t, 4, o>, buffer_count_load<t, 5, o>, \
+      buffer_count_load<t, 6, o>, buffer_count_load<t, 7, o> }
+#define BUFFER_LOAD_FNS(t, o)                                            \
+    { buffer_load<t, 0, o>, buffer_load<t, 1, o>, buffer_load<t, 2, o>, buffer_load<t, 3, o>, \
+      buffer_load<t, 4, o>, buffer_load<t, 5, o>, buffer_load<t, 6, o> }
+#define REPLAY_LOAD_FNS(t, l, e)                                         \
+    { replay_load<t, 0, l, e>, replay_load<t, 1, l, e>, replay_load<t, 2, l, e>, replay_load<t, 3, l, e>, \
+      replay_vector_load<t, 4, l, e>, replay_vector_load<t, 5, l, e>, replay_vector_load<t, 6, l, e> }
+#define REPLAY_LOAD_TYPE_FNS(l, e)                                       \
+    { REPLAY_LOAD_FNS(RIP_LOAD, l, e), REPLAY_LOAD_FNS(STACK_LOAD, l, e), REPLAY_LOAD_FNS(REG_LOAD, l, e), \
+      REPLAY_LOAD_FNS(GATHER_LOAD, l, e) }
+
+// By [overhead]
+static const count_load_fn_t count_load_fns[2][NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {
+    { COUNT_LOAD_FNS(RIP_LOAD, false), COUNT_LOAD_FNS(STACK_LOAD, false), COUNT_LOAD_FNS(REG_LOAD, false),
+      COUNT_LOAD_FNS(GATHER_LOAD, false) },
+    { COUNT_LOAD_FNS(RIP_LOAD, true), COUNT_LOAD_FNS(STACK_LOAD, true), COUNT_LOAD_FNS(REG_LOAD, true),
+      COUNT_LOAD_FNS(GATHER_LOAD, true) }
+};
+
+static const count_untracked_fn_t count_untracked_fns[2][NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {
+    { COUNT_UNTRACKED_FNS(RIP_LOAD, false), COUNT_UNTRACKED_FNS(STACK_LOAD, false), COUNT_UNTRACKED_FNS(REG_LOAD, false),
+      COUNT_UNTRACKED_FNS(GATHER_LOAD, false) },
+    { COUNT_UNTRACKED_FNS(RIP_LOAD, true), COUNT_UNTRACKED_FNS(STACK_LOAD, true), COUNT_UNTRACKED_FNS(REG_LOAD, true),
+      COUNT_UNTRACKED_FNS(GATHER_LOAD, true) }
+};
+
+// By [locality][elim][overhead]
+static const capture_load_fn_t capture_load_fns[2][2][2][NUM_LOAD_TYPES][NUM_TRACKED_LOAD_SIZES] = {
+    { { CAPTURE_LOAD_TYPE_FNS(false, false, false), CAPTURE_LOAD_TYPE_FNS(false, false, true) },
+      { CAPTURE_LOAD_TYPE_FNS(false, true, false), CAPTURE_LOAD_TYPE_FNS(false, true, true) } },
+    { { CAPTURE_LOAD_TYPE_FNS(true, false, false), CAPTURE_LOAD_TYPE_FNS(true, false, true) },
+      { CAPTURE_LOAD_TYPE_FNS(true, true, false), CAPTURE_LOAD_TYPE_FNS(true, true, true) } }
+};
+
+// By [overhead], with -buffered
+static const count_load_fn_t buffer_count_load_fns[2][NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {
+    { BUFFER_COUNT_LOAD_FNS(RIP_LOAD, false), BUFFER_COUNT_LOAD_FNS(STACK_LOAD, false), BUFFER_COUNT_LOAD_FNS(REG_LOAD, false),
+      BUFFER_COUNT_LOAD_FNS(GATHER_LOAD, false) },
+    { BUFFER_COUNT_LOAD_FNS(RIP_LOAD, true), BUFFER_COUNT_LOAD_FNS(STACK_LOAD, true), BUFFER_COUNT_LOAD_FNS(REG_LOAD, true),
+      BUFFER_COUNT_LOAD_FNS(GATHER_LOAD, true) }
+};
+
+static const capture_load_fn_t buffer_load_fns[2][NUM_LOAD_TYPES][NUM_TRACKED_LOAD_SIZES] = {
+    { BUFFER_LOAD_FNS(RIP_LOAD, false), BUFFER_LOAD_FNS(STACK_LOAD, false), BUFFER_LOAD_FNS(REG_LOAD, false),
+      BUFFER_LOAD_FNS(GATHER_LOAD, false) },
+    { BUFFER_LOAD_FNS(RIP_LOAD, true), BUFFER_LOAD_FNS(STACK_LOAD, true), BUFFER_LOAD_FNS(REG_LOAD, true),
+      BUFFER_LOAD_FNS(GATHER_LOAD, true) }
+};
 
-    agen_icount++;
+// By [locality][elim], run by the workers
+static const replay_load_fn_t replay_load_fns[2][2][NUM_LOAD_TYPES][NUM_TRACKED_LOAD_SIZES] = {
+    { REPLAY_LOAD_TYPE_FNS(false, false), REPLAY_LOAD_TYPE_FNS(false, true) },
+    { REPLAY_LOAD_TYPE_FNS(true, false), REPLAY_LOAD_TYPE_FNS(true, true) }
+};
+
+// Chosen once the knobs are known
+static const count_load_fn_t (*count_fns)[NUM_LOAD_SIZES] = count_load_fns[0];
+static const count_untracked_fn_t (*untracked_fns)[NUM_LOAD_SIZES] = count_untracked_fns[0];
+static const capture_load_fn_t (*capture_fns)[NUM_TRACKED_LOAD_SIZES] = capture_load_fns[0][0][0];
+static const replay_load_fn_t (*replay_fns)[NUM_TRACKED_LOAD_SIZES] = replay_load_fns[0][0];
+
+static VOID replay_record(THREADID tid, thread_stats_t* ts, const load_record_t* rec)
+{
+    if (rec->count_only)
+        count_load_slot(ts, rec->slot, rec->load_type, rec->sizeb);
+    else
+        replay_fns[rec->load_type][rec->sizeb](tid, ts, rec);
+}
+
+//-------------------------------//
+// What mem_agen needs to know about an instruction, decoded once
+// when it is first instrumented. Memory references are numbered
+// by SDE; those of a multi-reference load are its elements, each
+// with its own slot and the GATHER type, while the references of
+// other instructions map to their memory operands.
+//-------------------------------//
+const uint32_t MAX_AGEN_MEMOPS = 2;
+
+typedef struct
+{
+    uint32_t slot;              // first slot, or UNTRACKED_SLOT
+    uint32_t num_elements;      // element slots; zero if references are memory operands
+    uint32_t num_memops;
+    uint8_t load_type[MAX_AGEN_MEMOPS];
+} agen_desc_t;
+
+// By IP, so re-instrumented code reuses them; guarded by load_slot_lock
+static std::unordered_map<uint64_t, agen_desc_t*> agen_descs;
+
+static BOOL is_multi_ref_load(xed_decoded_inst_t *xedd)
+{
+    return xed_decoded_inst_get_attribute(xedd, XED_ATTRIBUTE_GATHER)
+           || xed_decoded_inst_get_category(xedd) == XED_CATEGORY_AMX_TILE;
+}
+
+// Called under load_slot_lock. An IP reused by an instruction of
+// another shape gets a new descriptor; code instrumented with the
+// old one may still run, so that one is never freed.
+static agen_desc_t* get_agen_desc(INS ins, xed_decoded_inst_t *xedd)
+{
+    agen_desc_t shape = {};
+    shape.num_elements = is_multi_ref_load(xedd) ? MAX_LOAD_ELEMENTS : 0;
+    shape.num_memops = std::min<uint32_t>(std::max<uint32_t>(xed_decoded_inst_number_of_memory_operands(xedd), 1),
+                                          MAX_AGEN_MEMOPS);
+    for (uint32_t i = 0; i < shape.num_memops; i++)
+        shape.load_type[i] = get_load_type(mem_op_is_rip(xedd, i), mem_op_is_stack(xedd, i));
+
+    agen_desc_t*& desc = agen_descs[INS_Address(ins)];
+    if (desc && desc->num_elements == shape.num_elements && desc->num_memops == shape.num_memops
+        && !memcmp(desc->load_type, shape.load_type, sizeof(shape.load_type)))
+        return desc;
+
+    desc = new agen_desc_t(shape);
+    desc->slot = get_load_slot(INS_Address(ins), desc->num_elements);
+    return desc;
+}
+
+template <bool OVERHEAD>
+static VOID mem_agen(THREADID tid, const agen_desc_t* desc)
+{
+    thread_stats_t* ts = thread_stats[tid];
+    overhead_timer<OVERHEAD> timer(ts->overhead, OH_MEM_AGEN);
+
+    unsigned int i, nrefs = 0;
+    {
+        overhead_timer<OVERHEAD> init_timer(ts->overhead, OH_SDE_AGEN_INIT);
+        if (!sde_agen_init(tid, &nrefs))
+            return;
+    }
+
+    ts->agen_icount++;
     for (i = 0; i < nrefs; i++)
     {
         sde_memop_info_t meminfo;
         sde_agen_address(tid, i, &meminfo);
 
-        BOOL is_rip   = mem_op_is_rip(xedd, i);
-        BOOL is_stack = mem_op_is_stack(xedd, i);
+        if (meminfo.memop_type == SDE_MEMOP_STORE && KnobTrackStores
+            && store_filter_hit(meminfo.memea, meminfo.bytes_per_ref))
+            queue_store(tid, meminfo.memea, meminfo.bytes_per_ref);
+
+        if (meminfo.memop_type != SDE_MEMOP_LOAD)
+            continue;
 
-        if (meminfo.memop_type == SDE_MEMOP_LOAD)
-            capture_load(ip, meminfo.memea, meminfo.bytes_per_ref, is_rip, is_stack);
+        // Element sizes are only known at run time here,
+        // so dispatch through the specialized routines
+        uint32_t sizeb = get_size_bucket(meminfo.bytes_per_ref);
+        load_type_t ltype;
+        UINT32 slot = desc->slot;
+        if (desc->num_elements)
+        {
+            ltype = GATHER_LOAD;
+            if (slot != UNTRACKED_SLOT)
+                slot += std::min(i, desc->num_elements - 1);
+        }
+        else
+            ltype = (load_type_t)desc->load_type[std::min(i, desc->num_memops - 1)];
+
+        if (slot == UNTRACKED_SLOT)
+            untracked_fns[ltype][sizeb](tid);
+        else if (sizeb < NUM_TRACKED_LOAD_SIZES)
+            capture_fns[ltype][sizeb](tid, slot, meminfo.memea);
+        else
+            count_fns[ltype][sizeb](tid, slot);
     }
 }
 
-// Is called for every instruction and instruments reads and writes
+static ADDRINT PIN_FAST_ANALYSIS_CALL store_may_hit_load(ADDRINT ea, UINT32 size)
+{
+    return store_filter_hit(ea, size);
+}
+
+static VOID PIN_FAST_ANALYSIS_CALL capture_store(THREADID tid, ADDRINT ea, UINT32 size)
+{
+    queue_store(tid, ea, size);
+}
+
+static ADDRINT PIN_FAST_ANALYSIS_CALL stores_queued(THREADID tid)
+{
+    return store_pending[tid].num;
+}
+
+static VOID check_stores(THREADID tid)
+{
+    check_queued_stores(tid);
+}
+
+// Checks queued stores once the instruction has written memory.
+// Without a fall-through or taken-branch point the queue is
+// drained after the next store instead.
+static VOID instrument_store_check(INS ins)
+{
+    IPOINT ipoint;
+    if (INS_IsValidForIpointAfter(ins))
+        ipoint = IPOINT_AFTER;
+    else if (INS_IsValidForIpointTakenBranch(ins))
+        ipoint = IPOINT_TAKEN_BRANCH;
+    else
+        return;
+
+    INS_InsertIfCall(ins, ipoint, (AFUNPTR)stores_queued, IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_END);
+    INS_InsertThenCall(ins, ipoint, (AFUNPTR)check_stores, IARG_THREAD_ID, IARG_END);
+}
+
+// Is called for every instruction and instruments reads and writes.
+// With sampling, it is called from Trace() for sampled traces only.
 VOID Instruction(INS ins, VOID* v)
 {
+    // Outside the ROI only the icount is tracked
+    if (!inside_roi)
+        return;
+
     xed_decoded_inst_t *xedd = INS_XedDec(ins);
     sde_bool_t agen_attr = sde_agen_is_agen_required(xedd);
 
     if (agen_attr)
     {
-        INS_InsertCall(ins, IPOINT_BEFORE, (AFUNPTR)mem_agen, IARG_THREAD_ID, IARG_INST_PTR, IARG_PTR, xedd, IARG_END);
+        PIN_GetLock(&load_slot_lock, PIN_ThreadId() + 1);
+        const agen_desc_t* desc = get_agen_desc(ins, xedd);
+        if (hotspot_top)
+            attribute_load_slots(ins, desc->slot, desc->num_elements);
+        PIN_ReleaseLock(&load_slot_lock);
+
+        INS_InsertCall(ins, IPOINT_BEFORE, (KnobOverhead ? AFUNPTR(mem_agen<true>) : AFUNPTR(mem_agen<false>)), IARG_THREAD_ID, IARG_PTR, desc, IARG_END);
+        if (KnobTrackStores && INS_IsMemoryWrite(ins))
+            instrument_store_check(ins);
         return;
     }
 
-    if (INS_IsMemoryRead(ins) && INS_IsStandardMemop(ins))
+    if (KnobTrackStores && INS_IsMemoryWrite(ins) && INS_IsStandardMemop(ins))
     {
-        BOOL is_rip = mem_op_is_rip(xedd, 0);
-        BOOL is_stack = mem_op_is_stack(xedd, 0);
-
-        INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)capture_load, IARG_INST_PTR, IARG_MEMORYREAD_EA,
-                                 IARG_MEMORYREAD_SIZE, IARG_BOOL, is_rip, IARG_BOOL, is_stack, IARG_END);
+        INS_InsertIfPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)store_may_hit_load, IARG_FAST_ANALYSIS_CALL,
+                                   IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_SIZE, IARG_END);
+        INS_InsertThenPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)capture_store, IARG_FAST_ANALYSIS_CALL,
+                                     IARG_THREAD_ID, IARG_MEMORYWRITE_EA, IARG_MEMORYWRITE_SIZE, IARG_END);
+        instrument_store_check(ins);
     }
 
-    if (INS_HasMemoryRead2(ins) && INS_IsStandardMemop(ins))
+    if (!INS_IsMemoryRead(ins) || !INS_IsStandardMemop(ins))
+        return;
+
+    // Both read operands of an instruction share the IP's slot
+    PIN_GetLock(&load_slot_lock, PIN_ThreadId() + 1);
+    UINT32 slot = get_load_slot(INS_Address(ins));
+    BOOL untracked = (slot == UNTRACKED_SLOT);
+    BOOL pruned = !untracked && load_slot_pruned[slot] && prune_slots;
+    if (hotspot_top)
+        attribute_load_slots(ins, slot, 1);
+    PIN_ReleaseLock(&load_slot_lock);
+
+    UINT32 nreads = INS_HasMemoryRead2(ins) ? 2 : 1;
+    for (UINT32 i = 0; i < nreads; i++)
     {
-        BOOL is_rip = mem_op_is_rip(xedd, 1);
-        BOOL is_stack = mem_op_is_stack(xedd, 1);
+        load_type_t ltype = get_load_type(mem_op_is_rip(xedd, i), mem_op_is_stack(xedd, i));
+        uint32_t sizeb = get_size_bucket(INS_MemoryReadSize(ins));
+
+        if (untracked)
+        {
+            INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)untracked_fns[ltype][sizeb],
+                                     IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_END);
+            continue;
+        }
+
+        // Known unstable or not tracked: only the histogram needs updating
+        if (pruned || sizeb >= NUM_TRACKED_LOAD_SIZES)
+        {
+            INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)count_fns[ltype][sizeb],
+                                     IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_UINT32, slot, IARG_END);
+            continue;
+        }
 
-        INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)capture_load, IARG_INST_PTR, IARG_MEMORYREAD2_EA,
-                                 IARG_MEMORYREAD_SIZE, IARG_BOOL, is_rip, IARG_BOOL, is_stack, IARG_END);
+        INS_InsertPredicatedCall(ins, IPOINT_BEFORE, (AFUNPTR)capture_fns[ltype][sizeb],
+                                 IARG_FAST_ANALYSIS_CALL, IARG_THREAD_ID, IARG_UINT32, slot,
+                                 i == 0 ? IARG_MEMORYREAD_EA : IARG_MEMORYREAD2_EA, IARG_END);
     }
 }
 
 // This function is called before every block
 // Use the fast linkage for calls
-VOID PIN_FAST_ANALYSIS_CALL docount(ADDRINT c)
+// Counters are per thread, so no atomics are needed
+template <bool OVERHEAD>
+VOID PIN_FAST_ANALYSIS_CALL docount(THREADID tid, ADDRINT c)
+{
+    if (OVERHEAD)
+        thread_stats[tid]->overhead.calls[OH_DOCOUNT]++;
+    thread_ins_counter[tid]._count += c;
+}
+
+template <bool OVERHEAD>
+VOID PIN_FAST_ANALYSIS_CALL docount_roi(THREADID tid, ADDRINT c)
+{
+    if (OVERHEAD)
+        thread_stats[tid]->overhead.calls[OH_DOCOUNT]++;
+    thread_ins_counter[tid]._count += c;
+    thread_ins_counter_inside_roi[tid]._count += c;
+}
+
+// Interval mode variants, returning whether a snapshot check is due
+template <bool OVERHEAD>
+ADDRINT PIN_FAST_ANALYSIS_CALL docount_if(THREADID tid, ADDRINT c)
+{
+    if (OVERHEAD)
+        thread_stats[tid]->overhead.calls[OH_DOCOUNT]++;
+    thread_ins_counter[tid]._count += c;
+    return thread_ins_counter[tid]._count >= thread_stats[tid]->next_interval_check;
+}
+
+template <bool OVERHEAD>
+ADDRINT PIN_FAST_ANALYSIS_CALL docount_roi_if(THREADID tid, ADDRINT c)
+{
+    if (OVERHEAD)
+        thread_stats[tid]->overhead.calls[OH_DOCOUNT]++;
+    thread_ins_counter[tid]._count += c;
+    thread_ins_counter_inside_roi[tid]._count += c;
+    return thread_ins_counter[tid]._count >= thread_stats[tid]->next_interval_check;
+}
+
+// By [inside ROI][overhead]
+static const AFUNPTR counter_fns[2][2] = {
+    { AFUNPTR(docount<false>), AFUNPTR(docount<true>) },
+    { AFUNPTR(docount_roi<false>), AFUNPTR(docount_roi<true>) }
+};
+static const AFUNPTR counter_if_fns[2][2] = {
+    { AFUNPTR(docount_if<false>), AFUNPTR(docount_if<true>) },
+    { AFUNPTR(docount_roi_if<false>), AFUNPTR(docount_roi_if<true>) }
+};
+
+// Sampling mode check. It is inserted before the block, while the
+// block counter may run before or after it (IPOINT_ANYWHERE, or a
+// later IPOINT_BEFORE call with -interval), so the toggle may be
+// seen one block late.
+ADDRINT PIN_FAST_ANALYSIS_CALL sample_due(THREADID tid)
 {
-    ATOMIC::OPS::Increment<UINT64>(&global_ins_counter._count, c);
-    if(inside_roi) ATOMIC::OPS::Increment<UINT64>(&global_ins_counter_inside_roi._count, c);
+    return thread_ins_counter[tid]._count >= thread_stats[tid]->next_sample_toggle;
+}
+
+// Sampling mode: sends the thread to the other trace version when
+// the sample register disagrees with the version of this trace
+static VOID instrument_sampling(TRACE trace)
+{
+    ADDRINT version = TRACE_Version(trace);
+    ADDRINT other = (version == SAMPLE_ON) ? SAMPLE_OFF : SAMPLE_ON;
+    INS_InsertVersionCase(BBL_InsHead(TRACE_BblHead(trace)), sample_reg, other, other, IARG_END);
+
+    for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl))
+    {
+        BBL_InsertIfCall(bbl, IPOINT_BEFORE, AFUNPTR(sample_due), IARG_FAST_ANALYSIS_CALL,
+                         IARG_THREAD_ID, IARG_END);
+        BBL_InsertThenCall(bbl, IPOINT_BEFORE, AFUNPTR(sample_toggle), IARG_THREAD_ID,
+                           IARG_RETURN_REGS, sample_reg, IARG_END);
+
+        if (version == SAMPLE_ON)
+            for (INS ins = BBL_InsHead(bbl); INS_Valid(ins); ins = INS_Next(ins))
+                Instruction(ins, 0);
+    }
 }
 
 // Pin calls this function every time a new basic block is encountered
-// It inserts a call to docount
+// It inserts a call to docount (docount_roi inside the ROI)
 VOID Trace(TRACE trace, VOID* v)
 {
+    AFUNPTR counter = counter_fns[inside_roi][KnobOverhead.Value()];
+    AFUNPTR counter_if = counter_if_fns[inside_roi][KnobOverhead.Value()];
+
+    if (sample_length)
+        instrument_sampling(trace);
+
+    if (hotspot_top)
+        note_loops(trace);
+
     // Visit every basic block  in the trace
     for (BBL bbl = TRACE_BblHead(trace); BBL_Valid(bbl); bbl = BBL_Next(bbl))
     {
-        BBL_InsertCall(bbl, IPOINT_ANYWHERE, AFUNPTR(docount), IARG_FAST_ANALYSIS_CALL,
-                       IARG_UINT32, BBL_NumIns(bbl), IARG_END);
+        if (interval_length)
+        {
+            BBL_InsertIfCall(bbl, IPOINT_BEFORE, counter_if, IARG_FAST_ANALYSIS_CALL,
+                             IARG_THREAD_ID, IARG_UINT32, BBL_NumIns(bbl), IARG_END);
+            BBL_InsertThenCall(bbl, IPOINT_BEFORE, AFUNPTR(interval_tick), IARG_THREAD_ID, IARG_END);
+            continue;
+        }
+
+        BBL_InsertCall(bbl, IPOINT_ANYWHERE, counter, IARG_FAST_ANALYSIS_CALL,
+                       IARG_THREAD_ID, IARG_UINT32, BBL_NumIns(bbl), IARG_END);
+    }
+}
+
+// Records the address range of every image, for image-relative output
+VOID ImageLoad(IMG img, VOID* v)
+{
+    add_image_range(IMG_Name(img), IMG_LowAddress(img), IMG_HighAddress(img) + 1);
+}
+
+// Ends the image's range, so code later mapped over it resolves to
+// the new image. For the stable load dump, also symbolizes the load
+// IPs of the image while its symbols are still around; IPs known
+// unstable are skipped.
+// The agen descriptors of the image are kept, like those superseded
+// in get_agen_desc: cached traces hold them, and a later image mapped
+// at the same IPs reuses those of the same shape.
+VOID ImageUnload(IMG img, VOID* v)
+{
+    uint64_t low = IMG_LowAddress(img), high = IMG_HighAddress(img) + 1;
+    std::vector<uint64_t> ips;
+
+    remove_image_range(low);
+
+    PIN_GetLock(&load_slot_lock, PIN_ThreadId() + 1);
+    if (KnobDumpStableLoads)
+        for (uint32_t slot = 0; slot < load_slot_ip.size(); ++slot)
+            if (load_slot_ip[slot] >= low && load_slot_ip[slot] < high && !load_slot_pruned[slot])
+                ips.push_back(load_slot_ip[slot]);
+    PIN_ReleaseLock(&load_slot_lock);
+
+    if (KnobDumpStableLoads)
+        symbolize_ips(ips);
+}
+
+// Allocates the stats shard of a new thread
+VOID ThreadStart(THREADID tid, CONTEXT* ctxt, INT32 flags, VOID* v)
+{
+    // Pin may recycle a thread id; keep accumulating into the old shard
+    if (!thread_stats[tid])
+    {
+        thread_stats[tid] = new thread_stats_t();
+        thread_stats[tid]->next_interval_check = interval_check_stride;
     }
+
+    if (sample_length)
+        start_sampling(tid, ctxt);
+
+    if (load_buffer_bytes)
+        init_load_buffer(tid);
+
+    if (!elim_configs.empty())
+        init_elim_tables(tid);
+
+    PIN_GetLock(&output_lock, tid + 1);
+    if (tid >= num_thread_ids)
+        num_thread_ids = tid + 1;
+    PIN_ReleaseLock(&output_lock);
 }
 
 VOID fini(INT32 code, VOID *v)
 {
+    // the workers are gone by now (see stop_load_workers)
+    if (load_buffer_bytes)
+        flush_load_buffers();
+
+    if (interval_length)
+        fini_intervals();
+
+    fini_live_export();
+
+    if (regions_enabled)
+        dump_region_stats(KnobRegionFilename.Value());
+
     dump_stats(
                KnobStatsFilename.Value(), 
                KnobDumpStableLoads, 
-               KnobStableLoadsFilename.Value());
+               KnobStableLoadsFilename.Value(),
+               KnobTrackStores);
+
+    if (sample_length)
+        dump_sampling_stats(KnobStatsFilename.Value());
+
+    if (KnobLocality)
+        dump_locality_stats(KnobStatsFilename.Value());
+
+    if (load_buffer_bytes)
+        dump_buffer_stats(KnobStatsFilename.Value());
+
+    if (!elim_configs.empty())
+        dump_elim_stats(KnobStatsFilename.Value());
+
+    if (hotspot_top)
+        dump_hotspots(KnobHotspotFilename.Value());
+
+    if (KnobOverhead)
+    {
+        overhead_t oh;
+        for (uint32_t tid = 0; tid < PIN_MAX_THREADS; ++tid)
+        {
+            if (!thread_stats[tid])
+                continue;
+            for (uint32_t routine = 0; routine < NUM_OH_ROUTINES; ++routine)
+            {
+                oh.calls[routine] += thread_stats[tid]->overhead.calls[routine];
+                oh.timed_calls[routine] += thread_stats[tid]->overhead.timed_calls[routine];
+                oh.timed_cycles[routine] += thread_stats[tid]->overhead.timed_cycles[routine];
+            }
+        }
+        dump_overhead_stats(KnobStatsFilename.Value(), oh, inside_roi, load_ip2slot.lookups(), load_ip2slot.probes());
+    }
+
+    if (!KnobProfileFilename.Value().empty())
+        dump_load_profile(KnobProfileFilename.Value());
 }
 
 int main(int argc, char* argv[])
 {
     sde_pin_init(argc, argv);
+    // routine names of the dump and of the hotspots
+    if (KnobDumpStableLoads || KnobHotspots.Value())
+        PIN_InitSymbols();
     PIN_InitLock(&output_lock);
+    PIN_InitLock(&load_slot_lock);
+    PIN_InitLock(&store_lock);
+    PIN_InitLock(&arena_lock);
+
+    mem_cap = KnobMaxTableMB.Value() << 20;
+    hotspot_top = KnobHotspots.Value();
+
+    if (KnobInterval.Value())
+        init_intervals(KnobIntervalFilename.Value(), KnobInterval.Value());
+
+    if (KnobSampleWindow.Value())
+    {
+        // unsampled traces carry no store instrumentation either,
+        // so store classes would be meaningless
+        if (KnobTrackStores)
+        {
+            std::cerr << "-sample_window cannot be combined with -track_stores" << endl;
+            return 1;
+        }
+        if (KnobSamplePeriod.Value() <= KnobSampleWindow.Value())
+        {
+            std::cerr << "-sample_period must exceed -sample_window" << endl;
+            return 1;
+        }
+        if (!init_sampling(KnobSampleWindow.Value(), KnobSamplePeriod.Value()))
+        {
+            std::cerr << "no tool register left for sampling" << endl;
+            return 1;
+        }
+    }
+
+    if (!KnobElim.Value().empty() && !parse_elim_configs(KnobElim.Value()))
+    {
+        std::cerr << "-elim expects ENTRIES:WAYS:POLICY:CONFIDENCE[,...], with ENTRIES a multiple of WAYS"
+                  << " and POLICY one of lru, fifo or random" << endl;
+        return 1;
+    }
+    BOOL elim = !elim_configs.empty();
+
+    count_fns = count_load_fns[KnobOverhead.Value()];
+    untracked_fns = count_untracked_fns[KnobOverhead.Value()];
+    capture_fns = capture_load_fns[KnobLocality.Value()][elim][KnobOverhead.Value()];
+
+    if (KnobBuffered)
+    {
+        // records carry no sampling window, and stores would be
+        // checked against loads not analyzed yet
+        if (KnobSampleWindow.Value() || KnobTrackStores)
+        {
+            std::cerr << "-buffered cannot be combined with -sample_window or -track_stores" << endl;
+            return 1;
+        }
+        if (KnobBufferKB.Value() < 4 || KnobBufferCount.Value() < 2 || !KnobAnalysisThreads.Value())
+        {
+            std::cerr << "-buffered needs -buffer_kb of at least 4, -buffer_count of at least 2 and an analysis thread" << endl;
+            return 1;
+        }
+
+        count_fns = buffer_count_load_fns[KnobOverhead.Value()];
+        capture_fns = buffer_load_fns[KnobOverhead.Value()];
+        replay_fns = replay_load_fns[KnobLocality.Value()][elim];
+        replay_load_record = replay_record;
+        if (!start_load_workers((uint64_t)KnobBufferKB.Value() << 10, KnobBufferCount.Value(),
+                                KnobAnalysisThreads.Value()))
+        {
+            std::cerr << "cannot start the analysis threads" << endl;
+            return 1;
+        }
+        PIN_AddPrepareForFiniFunction(stop_load_workers, 0);
+    }
+
+    if (!KnobLiveFilename.Value().empty() || KnobSnapshotSignal.Value() || !KnobSnapshotTrigger.Value().empty())
+    {
+        if (KnobLiveMs.Value() < LIVE_TICK_MS)
+        {
+            std::cerr << "-live_ms must be at least " << LIVE_TICK_MS << endl;
+            return 1;
+        }
+        if (!start_live_export(KnobLiveFilename.Value(), KnobLiveMs.Value(), KnobSnapshotSignal.Value(),
+                               KnobSnapshotTrigger.Value(), KnobSnapshotPrefix.Value()))
+        {
+            std::cerr << "cannot start the live stats export" << endl;
+            return 1;
+        }
+        PIN_AddPrepareForFiniFunction(stop_live_export, 0);
+    }
+
+    if (KnobOverhead)
+        CODECACHE_AddCacheFlushedFunction(code_cache_flushed, 0);
+
+    if (KnobLocality)
+    {
+        locality_tables = TRUE;
+        locality_threshold = KnobLocalityThreshold.Value();
+    }
 
-    INS_AddInstrumentFunction(Instruction, 0);
+    PIN_AddThreadStartFunction(ThreadStart, 0);
+    IMG_AddInstrumentFunction(ImageLoad, 0);
+    IMG_AddUnloadFunction(ImageUnload, 0);
+    // with sampling, Trace() instruments the sampled version
+    if (!sample_length)
+        INS_AddInstrumentFunction(Instruction, 0);
     TRACE_AddInstrumentFunction(Trace, 0);
 
     //Register handler on SDE's controller, must be done before PIN_StartProgram
@@ -276,6 +1280,8 @@ int main(int argc, char* argv[])
     sde_init();
 
     pcregions.Activate();
+    regions_enabled = pcregions.IsActive();
+    prune_slots = !regions_enabled && !KnobLocality && !elim;
 
     // Fini function
     PIN_AddFiniFunction(fini, 0);
@@ -0,0 +1,112 @@
+/**********************************************************
+ * Interval snapshots of Load Inspector
+ * Appends one line of load statistics every N instructions,
+ * so phase behaviour of long runs becomes visible.
+ **********************************************************/
+
+#ifndef INTERVAL_H
+#define INTERVAL_H
+
+#include "stats.h"
+
+static uint64_t interval_length = 0; // zero disables snapshots
+static uint64_t interval_check_stride = 0;
+static volatile uint64_t interval_next_icount = 0;
+static uint64_t interval_id = 0;
+static uint64_t interval_last_icount = 0;
+static PIN_LOCK interval_lock;
+static std::ofstream interval_file;
+
+// Totals at the previous snapshot; only deltas are written
+static uint64_t interval_prev_load_count[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {};
+static uint64_t interval_prev_stable_ips = 0;
+static uint64_t interval_prev_unstable_ips = 0;
+
+static void init_intervals(std::string interval_filename, uint64_t length)
+{
+    interval_length = length;
+    interval_check_stride = std::max<uint64_t>(length / 16, 1);
+    interval_next_icount = length;
+    PIN_InitLock(&interval_lock);
+
+    interval_file.open(interval_filename.c_str());
+    interval_file << "# interval icount icount.inside_roi new_stable_ips new_unstable_ips load_ips live_load_ips";
+    FOREACH_LOAD_TYPE_SIZE({
+        interval_file << " load." << load_type_t2str[type] << "." << load_size2str[size];
+    });
+    interval_file << std::endl;
+}
+
+//-------------------------------//
+// Writes one snapshot line
+// Counters of running threads are read without stopping them,
+// so a snapshot may be off by the loads in flight.
+//-------------------------------//
+static void write_interval_snapshot(uint64_t icount)
+{
+    uint64_t cur_load_count[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {};
+
+    for (uint32_t tid = 0; tid < num_thread_ids; ++tid)
+    {
+        thread_stats_t* ts = thread_stats[tid];
+        if (!ts)
+            continue;
+        FOREACH_LOAD_TYPE_SIZE({
+            cur_load_count[type][size] += ts->load_count[type][size];
+        });
+    }
+
+    // IPs are counted once, when first seen repeating or unstable;
+    // an IP can be counted as stable, then as unstable later
+    uint64_t stable_ips = repeated_load_ips;
+    uint64_t unstable_ips = pruned_load_ips;
+
+    interval_file << interval_id++
+                  << " " << icount
+                  << " " << sum_thread_counters(thread_ins_counter_inside_roi)
+                  << " " << stable_ips - interval_prev_stable_ips
+                  << " " << unstable_ips - interval_prev_unstable_ips
+                  << " " << num_load_slots
+                  << " " << num_load_slots - unstable_ips;
+    FOREACH_LOAD_TYPE_SIZE({
+        interval_file << " " << cur_load_count[type][size] - interval_prev_load_count[type][size];
+        interval_prev_load_count[type][size] = cur_load_count[type][size];
+    });
+    interval_file << std::endl;
+
+    interval_prev_stable_ips = stable_ips;
+    interval_prev_unstable_ips = unstable_ips;
+    interval_last_icount = icount;
+}
+
+// Called by each thread every interval_check_stride of its own
+// instructions; writes a snapshot once the global icount crossed
+// the next interval boundary
+static void interval_tick(THREADID tid)
+{
+    thread_stats[tid]->next_interval_check = thread_ins_counter[tid]._count + interval_check_stride;
+
+    uint64_t icount = sum_thread_counters(thread_ins_counter);
+    if (icount < interval_next_icount)
+        return;
+
+    PIN_GetLock(&interval_lock, tid + 1);
+    if (icount >= interval_next_icount)
+    {
+        write_interval_snapshot(icount);
+        while (interval_next_icount <= icount)
+            interval_next_icount += interval_length;
+    }
+    PIN_ReleaseLock(&interval_lock);
+}
+
+// Writes the last, partial interval
+static void fini_intervals()
+{
+    uint64_t icount = sum_thread_counters(thread_ins_counter);
+    if (icount > interval_last_icount)
+        write_interval_snapshot(icount);
+    interval_file.close();
+}
+
+#endif
@@ -0,0 +1,227 @@
+/**********************************************************
+ * Live stats of Load Inspector
+ * For targets that run for long or never exit, an internal
+ * thread exports the counters while the target runs: into a
+ * shared file mapping rewritten every -live_ms (-live_file),
+ * and as stats snapshots written on a signal (-snapshot_signal)
+ * or when a trigger file appears (-snapshot_trigger).
+ * Application threads are never stopped; like the interval
+ * snapshots, the counters are read as their threads go on.
+ **********************************************************/
+
+#ifndef LIVE_H
+#define LIVE_H
+
+#include <fcntl.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stats.h"
+#include "live_format.h"
+
+static_assert(LIVE_NUM_LOAD_TYPES == NUM_LOAD_TYPES && LIVE_NUM_LOAD_SIZES == NUM_LOAD_SIZES
+              && LIVE_NUM_MEM_TABLES == NUM_MEM_TABLES, "live_format.h is out of date");
+
+// How often the exporter looks for a snapshot request
+const uint32_t LIVE_TICK_MS = 10;
+
+static uint32_t live_period_ms = 1000;
+static live_region_t* live_region = NULL;       // with -live_file
+static std::string live_trigger_file;           // with -snapshot_trigger
+static std::string live_snapshot_prefix;
+static uint32_t live_snapshot_id = 0;
+
+static volatile BOOL live_snapshot_requested = FALSE;
+static volatile BOOL live_stop = FALSE;
+static PIN_THREAD_UID live_uid;
+
+static void gather_live_counters(live_counters_t& c)
+{
+    memset(&c, 0, sizeof(c));
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    c.time_ns = (uint64_t)now.tv_sec * 1000000000 + now.tv_nsec;
+
+    c.num_threads = num_thread_ids;
+    c.icount = sum_thread_counters(thread_ins_counter);
+    c.icount_inside_roi = sum_thread_counters(thread_ins_counter_inside_roi);
+    for (uint32_t tid = 0; tid < c.num_threads; ++tid)
+    {
+        const thread_stats_t* ts = thread_stats[tid];
+        if (!ts)
+            continue;
+        FOREACH_LOAD_TYPE_SIZE({
+            c.load_count[type][size] += ts->load_count[type][size];
+        });
+    }
+
+    c.load_ips = num_load_slots;
+    c.new_stable_ips = repeated_load_ips;
+    c.unstable_ips = pruned_load_ips;
+    c.untracked_load_ips = untracked_load_ips;
+    for (uint32_t table = 0; table < NUM_MEM_TABLES; ++table)
+        c.mem_table_bytes[table] = mem_table_bytes[table];
+    c.mem_tables_peak_bytes = mem_table_peak;
+}
+
+// Maps the live region; returns FALSE if the file cannot be set up
+static BOOL open_live_region(const std::string& filename)
+{
+    int fd = open(filename.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0)
+        return FALSE;
+    if (ftruncate(fd, sizeof(live_region_t)))
+    {
+        close(fd);
+        return FALSE;
+    }
+    void* region = mmap(NULL, sizeof(live_region_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (region == MAP_FAILED)
+        return FALSE;
+
+    live_region = (live_region_t*)region;
+    memcpy(live_region->magic, LIVE_STATS_MAGIC, sizeof(live_region->magic));
+    live_region->version = LIVE_STATS_VERSION;
+    live_region->pid = getpid();
+    return TRUE;
+}
+
+// Writes the copy readers are not on, then publishes it. The fence
+// keeps the writes of the copy after the previous publish, which
+// readers of this copy check seq against.
+static void publish_live_counters(const live_counters_t& c)
+{
+    uint64_t seq = live_region->seq + 1;
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    live_counters_t& copy = live_region->copies[seq & 1];
+    copy = c;
+    copy.seq = seq;
+    __atomic_store_n(&live_region->seq, seq, __ATOMIC_RELEASE);
+}
+
+//-------------------------------//
+// Writes <prefix>.<id>.txt, in the format of the stats file, so
+// the tools reading it read snapshots too. Only the counters
+// kept as the target runs are in it; load IP stability is only
+// known once the shards are merged at fini.
+//-------------------------------//
+static void write_live_snapshot(const live_counters_t& c)
+{
+    std::ostringstream filename;
+    filename << live_snapshot_prefix << "." << live_snapshot_id << ".txt";
+
+    uint64_t total_loads = 0;
+    FOREACH_LOAD_TYPE_SIZE({
+        total_loads += c.load_count[type][size];
+    });
+
+    std::ofstream stats;
+    stats.open(filename.str().c_str());
+
+    stats << "snapshot.id " << live_snapshot_id++ << std::endl;
+    stats << "snapshot.time_ns " << c.time_ns << std::endl;
+    stats << "snapshot.threads " << c.num_threads << std::endl;
+    stats << std::endl;
+
+    stats << "icount.total " << c.icount << std::endl;
+    stats << "icount.inside_roi " << c.icount_inside_roi << std::endl;
+    stats << std::endl;
+
+    stats << "load.total " << total_loads << std::endl;
+    FOREACH_LOAD_TYPE_SIZE({
+        stats << "load." << load_type_t2str[type] << "." << load_size2str[size] << " " << c.load_count[type][size] << std::endl;
+    });
+    stats << std::endl;
+
+    stats << "snapshot.load_ips " << c.load_ips << std::endl;
+    stats << "snapshot.new_stable_ips " << c.new_stable_ips << std::endl;
+    stats << "prune.unstable_ips " << c.unstable_ips << std::endl;
+    stats << "mem.untracked_load_ips " << c.untracked_load_ips << std::endl;
+    for (uint32_t table = 0; table < NUM_MEM_TABLES; ++table)
+        stats << "mem." << mem_table_t2str[table] << ".bytes " << c.mem_table_bytes[table] << std::endl;
+    stats << "mem.tables.peak_bytes " << c.mem_tables_peak_bytes << std::endl;
+    stats << "mem.rss_bytes " << read_proc_status_bytes("VmRSS") << std::endl;
+
+    stats.close();
+}
+
+// Runs on the application thread that got the signal; the
+// signal is not passed on to the target
+static BOOL intercept_snapshot_signal(THREADID tid, INT32 sig, CONTEXT* ctxt, BOOL has_handler,
+                                      const EXCEPTION_INFO* info, VOID* v)
+{
+    live_snapshot_requested = TRUE;
+    return FALSE;
+}
+
+//-------------------------------//
+// Exporter thread; updates the live region every period and
+// writes a snapshot when one is requested, until told to stop.
+//-------------------------------//
+static VOID live_exporter(VOID* arg)
+{
+    uint32_t elapsed_ms = 0;
+    while (!live_stop)
+    {
+        PIN_Sleep(LIVE_TICK_MS);
+        elapsed_ms += LIVE_TICK_MS;
+
+        BOOL update = (elapsed_ms >= live_period_ms);
+        BOOL triggered = update && !live_trigger_file.empty() && !access(live_trigger_file.c_str(), F_OK);
+        if (!update && !live_snapshot_requested)
+            continue;
+
+        live_counters_t c;
+        gather_live_counters(c);
+        if (update)
+        {
+            elapsed_ms = 0;
+            if (live_region)
+                publish_live_counters(c);
+        }
+        if (triggered)
+            unlink(live_trigger_file.c_str());
+        if (triggered || live_snapshot_requested)
+        {
+            live_snapshot_requested = FALSE;
+            write_live_snapshot(c);
+        }
+    }
+}
+
+static BOOL start_live_export(const std::string& region_filename, uint32_t period_ms, uint32_t signal,
+                              const std::string& trigger_filename, const std::string& snapshot_prefix)
+{
+    live_period_ms = period_ms;
+    live_trigger_file = trigger_filename;
+    live_snapshot_prefix = snapshot_prefix;
+
+    if (!region_filename.empty() && !open_live_region(region_filename))
+        return FALSE;
+    if (signal && !PIN_InterceptSignal(signal, intercept_snapshot_signal, 0))
+        return FALSE;
+    return PIN_SpawnInternalThread(live_exporter, NULL, 0, &live_uid) != INVALID_THREADID;
+}
+
+// Called before fini, while application threads may still run
+static VOID stop_live_export(VOID* v)
+{
+    live_stop = TRUE;
+    PIN_WaitForThreadTermination(live_uid, PIN_INFINITE_TIMEOUT, NULL);
+}
+
+// Leaves the final counters in the region; called at fini
+static void fini_live_export()
+{
+    if (!live_region)
+        return;
+    live_counters_t c;
+    gather_live_counters(c);
+    c.done = 1;
+    publish_live_counters(c);
+}
+
+#endif
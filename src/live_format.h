@@ -0,0 +1,56 @@
+/**********************************************************
+ * Live stats region of Load Inspector (-live_file)
+ * A file the tool maps shared and rewrites every -live_ms, so
+ * the counters of a running target can be read in place.
+ * Shared by the tool and the reader in tools/.
+ *
+ * The region holds two copies of the counters. Update s + 1 is
+ * written into copies[(s + 1) & 1], then published by bumping seq
+ * to s + 1; copies[seq & 1] is the latest. Once seq is s + 1, the
+ * writer may start rewriting copies[s & 1] with update s + 2, so
+ * a reader that copied out copies[s & 1] re-reads seq and only
+ * keeps the copy if seq is still s; otherwise it retries.
+ **********************************************************/
+
+#ifndef LIVE_FORMAT_H
+#define LIVE_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LIVE_STATS_MAGIC "LDINSLIV"
+
+const uint32_t LIVE_STATS_VERSION = 1;
+
+// Dimensions of the arrays below; checked against the tool's
+const uint32_t LIVE_NUM_LOAD_TYPES = 4;
+const uint32_t LIVE_NUM_LOAD_SIZES = 8;
+const uint32_t LIVE_NUM_MEM_TABLES = 4;
+
+typedef struct
+{
+    uint64_t seq;                   // update this copy was written by
+    uint64_t time_ns;               // CLOCK_REALTIME of the update
+    uint64_t icount;
+    uint64_t icount_inside_roi;
+    uint64_t load_count[LIVE_NUM_LOAD_TYPES][LIVE_NUM_LOAD_SIZES];
+    uint64_t load_ips;              // load slots handed out so far
+    uint64_t new_stable_ips;        // slots seen repeating so far, each counted once
+    uint64_t unstable_ips;
+    uint64_t untracked_load_ips;
+    uint64_t mem_table_bytes[LIVE_NUM_MEM_TABLES];
+    uint64_t mem_tables_peak_bytes;
+    uint32_t num_threads;
+    uint32_t done;                  // the final update, written at exit
+} live_counters_t;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t pid;
+    volatile uint64_t seq;          // zero until the first update
+    live_counters_t copies[2];
+} live_region_t;
+
+#endif
@@ -0,0 +1,147 @@
+/**********************************************************
+ * Load value locality classes of Load Inspector
+ * Beyond global-stable, classifies load IPs by whether their
+ * address or value repeats, and how well a last-value or a
+ * stride predictor would have done on them.
+ **********************************************************/
+
+#ifndef LOCALITY_H
+#define LOCALITY_H
+
+#include "stats.h"
+
+typedef enum
+{
+    SAME_ADDR_CHANGING_VALUE = 0,
+    SAME_VALUE_CHANGING_ADDR,
+    LAST_VALUE_PREDICTABLE,     // value changes, but mostly repeats the previous one
+    STRIDE_PREDICTABLE,         // address changes, but mostly by the previous stride
+    NUM_LOCALITY_CLASSES
+} locality_class_t;
+
+std::string locality_class_t2str[] = { "same_addr_changing_value", "same_value_changing_addr",
+                                       "last_value_predictable", "stride_predictable" };
+
+static uint32_t locality_threshold = 90; // hit rate in percent to be predictable
+
+// Returns the shard's locality state of a slot, growing it with the slots
+static inline locality_state_t& thread_locality(thread_stats_t* ts, uint32_t slot)
+{
+    if (slot >= ts->locality.size())
+        ts->locality.resize(num_load_slots);
+    return ts->locality[slot];
+}
+
+// Folds a vector value into 64 bits for the last-value compare
+static inline uint64_t locality_fold(const uint64_t* words, uint32_t nwords)
+{
+    uint64_t fold = 0;
+    for (uint32_t i = 0; i < nwords; i++)
+        fold = (fold * 0x9e3779b97f4a7c15ULL) ^ words[i];
+    return fold;
+}
+
+// Updates the locality of a slot with one execution; first is
+// whether the slot had not been executed before
+static inline void track_locality(locality_state_t& lc, BOOL first, uint64_t ea, uint64_t val)
+{
+    if (first)
+    {
+        lc.last_addr = ea;
+        lc.last_val = val;
+        return;
+    }
+
+    int64_t stride = (int64_t)(ea - lc.last_addr);
+    lc.value_hits += (val == lc.last_val);
+    lc.stride_hits += (stride == lc.last_stride);
+    lc.addr_changed |= (stride != 0);
+    lc.val_changed |= (val != lc.last_val);
+    lc.last_addr = ea;
+    lc.last_val = val;
+    lc.last_stride = (stride == (int32_t)stride) ? (int32_t)stride : LOCALITY_NO_STRIDE;
+}
+
+static inline BOOL is_locality_class(const load_slot_t& ls, const locality_state_t& lc, uint32_t lclass)
+{
+    uint64_t repeats = ls.occur - 1;
+    switch (lclass)
+    {
+        case SAME_ADDR_CHANGING_VALUE:
+            return !lc.addr_changed && lc.val_changed;
+        case SAME_VALUE_CHANGING_ADDR:
+            return lc.addr_changed && !lc.val_changed;
+        case LAST_VALUE_PREDICTABLE:
+            return lc.val_changed && lc.value_hits * 100 >= repeats * locality_threshold;
+        case STRIDE_PREDICTABLE:
+            return lc.addr_changed && lc.stride_hits * 100 >= repeats * locality_threshold;
+        default:
+            return FALSE;
+    }
+}
+
+//-------------------------------//
+// Appends the locality stats; must run after dump_stats.
+// Classes may overlap; only IPs executed more than once count.
+//-------------------------------//
+static void dump_locality_stats(std::string stats_filename)
+{
+    uint64_t num_class_ips[NUM_LOCALITY_CLASSES][NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {},
+             num_class_loads[NUM_LOCALITY_CLASSES][NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {},
+             value_hits[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {},
+             stride_hits[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {};
+
+    for (uint32_t slot = 0; slot < load_slots.size(); ++slot)
+    {
+        const load_slot_t& ls = load_slots[slot];
+        const locality_state_t& lc = load_locality[slot];
+        if (ls.occur <= 1)
+            continue;
+
+        value_hits[ls.load_type][ls.sizeb] += lc.value_hits;
+        stride_hits[ls.load_type][ls.sizeb] += lc.stride_hits;
+        for (uint32_t lclass = 0; lclass < NUM_LOCALITY_CLASSES; ++lclass)
+        {
+            if (!is_locality_class(ls, lc, lclass))
+                continue;
+            num_class_ips[lclass][ls.load_type][ls.sizeb]++;
+            num_class_loads[lclass][ls.load_type][ls.sizeb] += ls.occur;
+        }
+    }
+
+    std::ofstream stats;
+    stats.open(stats_filename.c_str(), std::ios::app);
+
+    stats << std::endl;
+    stats << "locality.threshold " << locality_threshold << std::endl;
+    for (uint32_t lclass = 0; lclass < NUM_LOCALITY_CLASSES; ++lclass)
+    {
+        uint64_t total_ips = 0, total_loads = 0;
+        FOREACH_LOAD_TYPE_SIZE({
+            total_ips += num_class_ips[lclass][type][size];
+            total_loads += num_class_loads[lclass][type][size];
+        });
+
+        const std::string& name = locality_class_t2str[lclass];
+        stats << name << "_load_ips.total " << total_ips << std::endl;
+        FOREACH_LOAD_TYPE_SIZE({
+            stats << name << "_load_ips." << load_type_t2str[type] << "." << load_size2str[size] << " " << num_class_ips[lclass][type][size] << std::endl;
+        });
+        stats << name << "_loads.total " << total_loads << std::endl;
+        FOREACH_LOAD_TYPE_SIZE({
+            stats << name << "_loads." << load_type_t2str[type] << "." << load_size2str[size] << " " << num_class_loads[lclass][type][size] << std::endl;
+        });
+        stats << std::endl;
+    }
+
+    FOREACH_LOAD_TYPE_SIZE({
+        stats << "locality.last_value_hits." << load_type_t2str[type] << "." << load_size2str[size] << " " << value_hits[type][size] << std::endl;
+    });
+    FOREACH_LOAD_TYPE_SIZE({
+        stats << "locality.stride_hits." << load_type_t2str[type] << "." << load_size2str[size] << " " << stride_hits[type][size] << std::endl;
+    });
+
+    stats.close();
+}
+
+#endif
@@ -0,0 +1,267 @@
+/**********************************************************
+ * Memory of the Load Inspector tables
+ * The per-IP tables are carved out of an arena in fixed-size
+ * chunks, and IPs map to slots through an open-addressing
+ * table, so the tool's own footprint is known at any time and
+ * can be capped with -max_table_mb.
+ **********************************************************/
+
+#ifndef MEMORY_H
+#define MEMORY_H
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+typedef enum
+{
+    MEM_IP_TABLE = 0,
+    MEM_SLOTS,
+    MEM_VECTOR_VALUES,
+    MEM_LOCALITY,
+    NUM_MEM_TABLES
+} mem_table_t;
+
+std::string mem_table_t2str[] = { "ip_table", "slots", "vector_values", "locality" };
+
+// Entries per table chunk; a chunk of slots is 32KB
+const uint32_t TABLE_CHUNK_SHIFT = 10;
+const uint32_t TABLE_CHUNK = 1 << TABLE_CHUNK_SHIFT;
+
+const uint64_t ARENA_BLOCK = 4 << 20;
+const uint64_t ARENA_ALIGN = 64;
+
+//-------------------------------//
+// Table memory accounting
+// Guarded by arena_lock; readers elsewhere may see a slightly
+// stale value, which is fine for the cap.
+//-------------------------------//
+static PIN_LOCK arena_lock;
+static uint64_t mem_cap = 0;        // bytes, zero for no cap
+static uint64_t mem_table_bytes[NUM_MEM_TABLES] = {};
+static uint64_t mem_table_peak = 0;
+static uint64_t arena_bytes = 0;    // reserved from the system
+static char* arena_cur = NULL;
+static uint64_t arena_left = 0;
+
+static uint64_t mem_table_total()
+{
+    uint64_t total = 0;
+    for (uint32_t table = 0; table < NUM_MEM_TABLES; ++table)
+        total += mem_table_bytes[table];
+    return total;
+}
+
+// Called under arena_lock
+static void mem_account_locked(mem_table_t table, int64_t bytes)
+{
+    mem_table_bytes[table] += bytes;
+    uint64_t total = mem_table_total();
+    if (total > mem_table_peak)
+        mem_table_peak = total;
+}
+
+static void mem_account(mem_table_t table, int64_t bytes)
+{
+    PIN_GetLock(&arena_lock, PIN_ThreadId() + 1);
+    mem_account_locked(table, bytes);
+    PIN_ReleaseLock(&arena_lock);
+}
+
+// Bump allocation out of large blocks; table chunks are never freed
+static void* arena_alloc(uint64_t bytes, mem_table_t table)
+{
+    bytes = (bytes + ARENA_ALIGN - 1) & ~(ARENA_ALIGN - 1);
+
+    PIN_GetLock(&arena_lock, PIN_ThreadId() + 1);
+    if (bytes > arena_left)
+    {
+        uint64_t block = std::max(bytes, ARENA_BLOCK) + ARENA_ALIGN;
+        char* base = (char*)malloc(block);
+        if (!base)
+        {
+            PIN_ReleaseLock(&arena_lock);
+            throw std::bad_alloc();
+        }
+        arena_bytes += block;
+        arena_cur = (char*)(((uintptr_t)base + ARENA_ALIGN - 1) & ~(uintptr_t)(ARENA_ALIGN - 1));
+        arena_left = block - (arena_cur - base);
+    }
+    void* chunk = arena_cur;
+    arena_cur += bytes;
+    arena_left -= bytes;
+    mem_account_locked(table, bytes);
+    PIN_ReleaseLock(&arena_lock);
+    return chunk;
+}
+
+//-------------------------------//
+// Per-thread table of fixed-size chunks out of the arena
+// Unlike a std::vector it grows without copying, so entries
+// never move and growing never needs twice the memory.
+//-------------------------------//
+template <typename T, mem_table_t TABLE>
+class chunked_table
+{
+  public:
+    size_t size() const { return _size; }
+    uint32_t num_chunks() const { return _num_chunks; }
+
+    T& operator[](size_t i) { return _chunks[i >> TABLE_CHUNK_SHIFT][i & (TABLE_CHUNK - 1)]; }
+    const T& operator[](size_t i) const { return _chunks[i >> TABLE_CHUNK_SHIFT][i & (TABLE_CHUNK - 1)]; }
+
+    // Only ever grows
+    void resize(size_t n)
+    {
+        while ((size_t)_num_chunks << TABLE_CHUNK_SHIFT < n)
+        {
+            T* chunk = (T*)arena_alloc(TABLE_CHUNK * sizeof(T), TABLE);
+            for (uint32_t i = 0; i < TABLE_CHUNK; i++)
+                new (&chunk[i]) T();
+            _chunks.push_back(chunk);
+            _num_chunks = _chunks.size();
+        }
+        if (n > _size)
+            _size = n;
+    }
+
+    void push_back(const T& value)
+    {
+        resize(_size + 1);
+        (*this)[_size - 1] = value;
+    }
+
+    void swap(chunked_table& other)
+    {
+        _chunks.swap(other._chunks);
+        std::swap(_size, other._size);
+        uint32_t num_chunks = _num_chunks;
+        _num_chunks = other._num_chunks;
+        other._num_chunks = num_chunks;
+    }
+
+  private:
+    std::vector<T*> _chunks;
+    size_t _size = 0;
+    volatile uint32_t _num_chunks = 0;  // read by get_load_slot of other threads
+};
+
+//-------------------------------//
+// Compact IP to slot map
+// Open addressing with linear probing over a flat array of
+// 16-byte entries, kept at most half full. Each entry also keeps
+// the number of slots of its IP.
+//-------------------------------//
+class compact_ip_table
+{
+  public:
+    static const uint32_t NOT_FOUND = ~0u;
+
+    uint64_t size() const { return _count; }
+    uint64_t bytes() const { return _capacity * sizeof(entry_t); }
+    uint64_t lookups() const { return _lookups; }
+    uint64_t probes() const { return _probes; }     // entries visited by lookups
+
+    // Bytes the next insert would add by growing the table
+    uint64_t grow_bytes() const
+    {
+        return (_count + 1) * 2 > _capacity ? std::max<uint64_t>(_capacity, MIN_CAPACITY) * sizeof(entry_t) : 0;
+    }
+
+    uint32_t find(uint64_t ip, uint32_t* num_slots = NULL) const
+    {
+        _lookups++;
+        if (!_capacity)
+            return NOT_FOUND;
+        for (uint64_t i = hash(ip);; i = (i + 1) & (_capacity - 1))
+        {
+            _probes++;
+            if (!_entries[i].num_slots)
+                return NOT_FOUND;
+            if (_entries[i].ip == ip)
+            {
+                if (num_slots)
+                    *num_slots = _entries[i].num_slots;
+                return _entries[i].slot;
+            }
+        }
+    }
+
+    // The IP must not be in the table yet
+    void insert(uint64_t ip, uint32_t slot, uint32_t num_slots)
+    {
+        if ((_count + 1) * 2 > _capacity)
+            grow();
+        place(ip, slot, num_slots);
+        _count++;
+    }
+
+  private:
+    typedef struct
+    {
+        uint64_t ip;
+        uint32_t slot;
+        uint32_t num_slots;     // zero if the entry is free
+    } entry_t;
+
+    static const uint64_t MIN_CAPACITY = 1024;
+
+    entry_t* _entries = NULL;
+    uint64_t _capacity = 0;     // power of two
+    uint64_t _count = 0;
+    mutable uint64_t _lookups = 0;
+    mutable uint64_t _probes = 0;
+
+    uint64_t hash(uint64_t ip) const
+    {
+        return (ip * 0x9e3779b97f4a7c15ULL) >> (64 - __builtin_ctzll(_capacity));
+    }
+
+    void place(uint64_t ip, uint32_t slot, uint32_t num_slots)
+    {
+        uint64_t i = hash(ip);
+        while (_entries[i].num_slots)
+            i = (i + 1) & (_capacity - 1);
+        _entries[i].ip = ip;
+        _entries[i].slot = slot;
+        _entries[i].num_slots = num_slots;
+    }
+
+    void grow()
+    {
+        entry_t* old_entries = _entries;
+        uint64_t old_capacity = _capacity;
+
+        _capacity = std::max(old_capacity * 2, MIN_CAPACITY);
+        _entries = (entry_t*)calloc(_capacity, sizeof(entry_t));
+        if (!_entries)
+            throw std::bad_alloc();
+        mem_account(MEM_IP_TABLE, _capacity * sizeof(entry_t));
+
+        for (uint64_t i = 0; i < old_capacity; i++)
+            if (old_entries[i].num_slots)
+                place(old_entries[i].ip, old_entries[i].slot, old_entries[i].num_slots);
+
+        free(old_entries);
+        mem_account(MEM_IP_TABLE, -(int64_t)(old_capacity * sizeof(entry_t)));
+    }
+};
+
+// Reads a "Vm*:" line of /proc/self/status, in bytes; 0 if unavailable
+static uint64_t read_proc_status_bytes(const std::string& field)
+{
+    std::ifstream status("/proc/self/status");
+    std::string line;
+    while (std::getline(status, line))
+    {
+        if (line.compare(0, field.size() + 1, field + ":"))
+            continue;
+        return strtoull(line.c_str() + field.size() + 1, NULL, 10) * 1024;
+    }
+    return 0;
+}
+
+#endif
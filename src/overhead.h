@@ -0,0 +1,144 @@
+/**********************************************************
+ * Self-profiling of Load Inspector (-overhead)
+ * Counts the calls of each analysis routine and times one in
+ * every OVERHEAD_SAMPLE of them with rdtsc. The analysis
+ * routines take an OVERHEAD template parameter, so without
+ * -overhead none of this is compiled into them.
+ **********************************************************/
+
+#ifndef OVERHEAD_H
+#define OVERHEAD_H
+
+#include <chrono>
+#include <fstream>
+#include <string>
+
+typedef enum
+{
+    OH_CAPTURE_LOAD = 0,
+    OH_CAPTURE_VECTOR_LOAD,
+    OH_COUNT_LOAD,
+    OH_COUNT_UNTRACKED_LOAD,
+    OH_MEM_AGEN,
+    OH_SDE_AGEN_INIT,           // part of mem_agen
+    OH_SAFECOPY,                // part of the capture routines
+    OH_DOCOUNT,                 // calls only; too short to time
+    NUM_OH_ROUTINES
+} overhead_routine_t;
+
+std::string overhead_routine_t2str[] = { "capture_load", "capture_vector_load", "count_load", "count_untracked_load",
+                                         "mem_agen", "sde_agen_init", "safecopy", "docount" };
+
+const uint64_t OVERHEAD_SAMPLE = 64; // power of two
+
+// Per-thread counters, part of the thread's stats shard
+typedef struct
+{
+    uint64_t calls[NUM_OH_ROUTINES] = {};
+    uint64_t timed_calls[NUM_OH_ROUTINES] = {};
+    uint64_t timed_cycles[NUM_OH_ROUTINES] = {};
+} overhead_t;
+
+//-------------------------------//
+// Counts a call, and times it if it is a sampled one, until the
+// timer goes out of scope. Compiles to nothing without OVERHEAD.
+//-------------------------------//
+template <bool OVERHEAD>
+class overhead_timer
+{
+  public:
+    overhead_timer(overhead_t& oh, overhead_routine_t routine) : _oh(oh), _routine(routine), _start(0)
+    {
+        if (OVERHEAD && !(oh.calls[routine]++ & (OVERHEAD_SAMPLE - 1)))
+            _start = __builtin_ia32_rdtsc();
+    }
+
+    ~overhead_timer()
+    {
+        if (OVERHEAD && _start)
+        {
+            _oh.timed_cycles[_routine] += __builtin_ia32_rdtsc() - _start;
+            _oh.timed_calls[_routine]++;
+        }
+    }
+
+  private:
+    overhead_t& _oh;
+    overhead_routine_t _routine;
+    uint64_t _start;
+};
+
+//-------------------------------//
+// Tool-wide overhead stats, updated outside the analysis routines
+//-------------------------------//
+static uint64_t code_cache_flushes = 0;      // full code cache flushes
+static uint64_t roi_reinstrumentations = 0;  // flushes requested on ROI transitions
+
+static std::chrono::steady_clock::time_point run_start = std::chrono::steady_clock::now();
+static std::chrono::steady_clock::time_point roi_start;
+static std::chrono::steady_clock::duration roi_wall_time = std::chrono::steady_clock::duration::zero();
+
+static void code_cache_flushed()
+{
+    code_cache_flushes++;
+}
+
+// Called on every ROI transition, under output_lock
+static void overhead_roi_transition(BOOL entering)
+{
+    roi_reinstrumentations++;
+    if (entering)
+        roi_start = std::chrono::steady_clock::now();
+    else
+        roi_wall_time += std::chrono::steady_clock::now() - roi_start;
+}
+
+//-------------------------------//
+// Appends the overhead section; totals are over every thread.
+// Cycles are extrapolated from the timed calls, and include
+// the rdtsc reads and the routines a routine calls itself.
+//-------------------------------//
+static void dump_overhead_stats(std::string stats_filename, const overhead_t& oh, BOOL inside_roi,
+                                uint64_t ip_table_lookups, uint64_t ip_table_probes)
+{
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration roi_time = roi_wall_time;
+    if (inside_roi)
+        roi_time += now - roi_start;
+    double total_seconds = std::chrono::duration<double>(now - run_start).count();
+    double roi_seconds = std::chrono::duration<double>(roi_time).count();
+
+    std::ofstream stats;
+    stats.open(stats_filename.c_str(), std::ios::app);
+
+    stats << std::endl;
+    stats << "overhead.sample " << OVERHEAD_SAMPLE << std::endl;
+    for (uint32_t routine = 0; routine < NUM_OH_ROUTINES; ++routine)
+    {
+        const std::string& name = overhead_routine_t2str[routine];
+        uint64_t cycles = oh.timed_calls[routine] ?
+                          oh.timed_cycles[routine] * oh.calls[routine] / oh.timed_calls[routine] : 0;
+        stats << "overhead." << name << ".calls " << oh.calls[routine] << std::endl;
+        if (routine == OH_DOCOUNT)
+            continue;
+        stats << "overhead." << name << ".cycles " << cycles << std::endl;
+        stats << "overhead." << name << ".cycles_per_call "
+              << (oh.timed_calls[routine] ? oh.timed_cycles[routine] / oh.timed_calls[routine] : 0) << std::endl;
+    }
+
+    stats << "overhead.ip_table.lookups " << ip_table_lookups << std::endl;
+    stats << "overhead.ip_table.avg_probes "
+          << (ip_table_lookups ? (double)ip_table_probes / ip_table_lookups : 0.0) << std::endl;
+    stats << "overhead.code_cache.bytes_used " << CODECACHE_CodeMemUsed() << std::endl;
+    stats << "overhead.code_cache.bytes_reserved " << CODECACHE_CodeMemReserved() << std::endl;
+    stats << "overhead.code_cache.traces " << CODECACHE_NumTracesInCache() << std::endl;
+    stats << "overhead.code_cache.flushes " << code_cache_flushes << std::endl;
+    stats << "overhead.roi_reinstrumentations " << roi_reinstrumentations << std::endl;
+    stats << "overhead.wall_seconds.total " << total_seconds << std::endl;
+    stats << "overhead.wall_seconds.inside_roi " << roi_seconds << std::endl;
+    stats << "overhead.wall_seconds.outside_roi " << total_seconds - roi_seconds << std::endl;
+
+    stats.close();
+}
+
+#endif
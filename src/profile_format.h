@@ -0,0 +1,93 @@
+/**********************************************************
+ * Binary per-IP load profile format of Load Inspector
+ * A fixed header, fixed-width records and an image table,
+ * so a profile can be mmap-ed and queried in place.
+ * Shared by the tool and the readers in tools/.
+ *
+ * Layout:
+ *   load_profile_header_t
+ *   load_profile_record_t[num_records]
+ *   load_profile_image_t[num_images]   at images_offset
+ *   image names                        at images_offset + num_images * sizeof(load_profile_image_t)
+ *
+ * Records are grouped by image and sorted by IP inside each
+ * image, and by element for the per-element records of a
+ * multi-reference load. Images are ordered by address, except the anonymous
+ * image (IPs outside any image, e.g. JIT code) which comes last
+ * and has low == 0, so offsets in it are the raw IPs.
+ **********************************************************/
+
+#ifndef PROFILE_FORMAT_H
+#define PROFILE_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define LOAD_PROFILE_MAGIC "LDINSPRF"
+
+const uint32_t LOAD_PROFILE_VERSION = 3;
+
+#define LOAD_PROFILE_ANON_IMAGE "[anonymous]"
+
+typedef enum
+{
+    PROFILE_STABLE = 0,     // same addr/value on every execution
+    PROFILE_UNSTABLE,
+    PROFILE_SEEN_ONCE,      // executed once, stability unknown
+    NUM_PROFILE_STATES
+} load_profile_state_t;
+
+typedef struct
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t record_size;
+    uint64_t num_records;
+    uint64_t icount;
+    uint64_t icount_inside_roi;
+    uint32_t num_images;
+    uint32_t reserved0;
+    uint64_t images_offset;
+    uint8_t reserved[8];
+} load_profile_header_t;
+
+typedef struct
+{
+    uint64_t ip;
+    uint64_t addr;          // first observed address
+    uint64_t val;           // first observed value; FNV-1a hash of it for vector loads
+    uint64_t count;         // dynamic executions
+    uint8_t load_type;      // load_type_t
+    uint8_t sizeb;          // size bucket, see load_size2str
+    uint8_t state;          // load_profile_state_t
+    uint8_t element;        // element of a multi-reference load, else 0
+    uint32_t image;         // index into the image table
+} load_profile_record_t;
+
+typedef struct
+{
+    uint64_t low;           // load address; image offset = ip - low
+    uint64_t high;
+    uint64_t first_record;
+    uint64_t num_records;
+    uint64_t name_offset;   // into the name area
+    uint64_t name_length;
+} load_profile_image_t;
+
+static_assert(sizeof(load_profile_header_t) == 64, "profile header must stay 64B");
+static_assert(sizeof(load_profile_record_t) == 40, "profile record must stay 40B");
+static_assert(sizeof(load_profile_image_t) == 48, "profile image must stay 48B");
+
+// Folds a vector value into the record's val field
+static inline uint64_t load_profile_hash_value(const void* val, size_t size)
+{
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= ((const uint8_t*)val)[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+#endif
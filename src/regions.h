@@ -0,0 +1,198 @@
+/**********************************************************
+ * Per-PC-region stats of Load Inspector
+ * With -pcregions:in, every simulation region of the
+ * pcregions.csv gets its own load histogram and slot
+ * tables, summarized per region and weighted across them.
+ **********************************************************/
+
+#ifndef REGIONS_H
+#define REGIONS_H
+
+#include "stats.h"
+
+typedef struct
+{
+    double weight = 0;          // 0-1, as read from pcregions.csv
+    double multiplier = 0;      // slices the region stands for
+    uint64_t entries = 0;       // times a thread entered it
+    uint64_t icount = 0;        // ROI instructions of all threads inside it
+    uint64_t load_count[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {};
+} region_info_t;
+
+static BOOL regions_enabled = FALSE;
+static std::map<uint32_t, region_info_t> region_infos;
+
+// Exchanges the live slot tables of a thread with the ones it keeps for a region
+static void swap_region_slots(THREADID tid, uint32_t rid)
+{
+    std::vector<thread_stats_t*>& shards = region_shards[rid];
+    if (shards.empty())
+        shards.assign(PIN_MAX_THREADS, NULL);
+    if (!shards[tid])
+        shards[tid] = new thread_stats_t();
+
+    thread_stats[tid]->slots.swap(shards[tid]->slots);
+    thread_stats[tid]->vector_values.swap(shards[tid]->vector_values);
+    thread_stats[tid]->locality.swap(shards[tid]->locality);
+}
+
+//-------------------------------//
+// Moves a thread into a region (or NO_REGION)
+// PC regions trigger per thread, so this runs on the thread itself
+// and never races with its analysis routines. Load counts stay
+// cumulative in the shard; the region gets the deltas.
+// Called under output_lock.
+//-------------------------------//
+static void switch_region(THREADID tid, uint32_t rid)
+{
+    thread_stats_t* ts = thread_stats[tid];
+    if (!ts || ts->region == rid)
+        return;
+
+    if (ts->region != NO_REGION)
+    {
+        region_info_t& ri = region_infos[ts->region];
+        ri.icount += thread_ins_counter_inside_roi[tid]._count - ts->region_start_icount;
+        FOREACH_LOAD_TYPE_SIZE({
+            ri.load_count[type][size] += ts->load_count[type][size] - ts->region_start_load_count[type][size];
+        });
+    }
+
+    swap_region_slots(tid, ts->region);
+    swap_region_slots(tid, rid);
+    ts->region = rid;
+
+    if (rid != NO_REGION)
+    {
+        region_infos[rid].entries++;
+        ts->region_start_icount = thread_ins_counter_inside_roi[tid]._count;
+        memcpy(ts->region_start_load_count, ts->load_count, sizeof(ts->load_count));
+    }
+}
+
+static void enter_region(THREADID tid, uint32_t rid, double weight, double multiplier)
+{
+    region_info_t& ri = region_infos[rid];
+    ri.weight = weight;
+    ri.multiplier = multiplier;
+    switch_region(tid, rid);
+}
+
+static void leave_region(THREADID tid)
+{
+    switch_region(tid, NO_REGION);
+}
+
+//-------------------------------//
+// Dumps the per-region stats and their weighted summary
+// Rates are per kilo-instruction of each region, weighted by the
+// region weights (normalized over the regions that ran);
+// projected counts scale each region by its multiplier.
+// Must run before dump_stats, which merges every shard again.
+//-------------------------------//
+static void dump_region_stats(std::string region_filename)
+{
+    for (uint32_t tid = 0; tid < PIN_MAX_THREADS; ++tid)
+        leave_region(tid);
+
+    std::ofstream stats;
+    stats.open(region_filename.c_str());
+
+    double total_weight = 0;
+    for (auto it = region_infos.begin(); it != region_infos.end(); ++it)
+        total_weight += it->second.weight;
+
+    double weighted_load_pki[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {},
+           weighted_stable_loads_pki[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {},
+           weighted_load_pki_total = 0,
+           weighted_stable_loads_pki_total = 0,
+           weighted_stable_loads_fraction = 0,
+           weighted_stable_load_ips_fraction = 0,
+           projected_loads = 0,
+           projected_stable_loads = 0;
+
+    for (auto it = region_infos.begin(); it != region_infos.end(); ++it)
+    {
+        uint32_t rid = it->first;
+        const region_info_t& ri = it->second;
+        std::string prefix = "region." + std::to_string(rid) + ".";
+
+        std::vector<thread_stats_t*> shards;
+        for (auto sit = region_shards[rid].begin(); sit != region_shards[rid].end(); ++sit)
+            if (*sit)
+                shards.push_back(*sit);
+        merge_thread_stats(shards);
+
+        uint64_t total_loads = 0, num_load_ips = 0, total_stable_load_ips = 0, total_stable_loads = 0;
+        uint64_t num_stable_loads[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {};
+        FOREACH_LOAD_TYPE_SIZE({
+            total_loads += ri.load_count[type][size];
+        });
+        for (uint32_t slot = 0; slot < load_slots.size(); ++slot)
+        {
+            const load_slot_t& ls = load_slots[slot];
+            if (!ls.occur)
+                continue;
+            num_load_ips++;
+            if (!ls.unstable && ls.occur > 1)
+            {
+                total_stable_load_ips++;
+                total_stable_loads += ls.occur;
+                num_stable_loads[ls.load_type][ls.sizeb] += ls.occur;
+            }
+        }
+
+        stats << prefix << "weight " << ri.weight << std::endl;
+        stats << prefix << "multiplier " << ri.multiplier << std::endl;
+        stats << prefix << "entries " << ri.entries << std::endl;
+        stats << prefix << "icount " << ri.icount << std::endl;
+        stats << prefix << "load.total " << total_loads << std::endl;
+        FOREACH_LOAD_TYPE_SIZE({
+            stats << prefix << "load." << load_type_t2str[type] << "." << load_size2str[size] << " " << ri.load_count[type][size] << std::endl;
+        });
+        stats << prefix << "load_ips.total " << num_load_ips << std::endl;
+        stats << prefix << "global_stable_load_ips.total " << total_stable_load_ips << std::endl;
+        stats << prefix << "global_stable_loads.total " << total_stable_loads << std::endl;
+        FOREACH_LOAD_TYPE_SIZE({
+            stats << prefix << "global_stable_loads." << load_type_t2str[type] << "." << load_size2str[size] << " " << num_stable_loads[type][size] << std::endl;
+        });
+        stats << std::endl;
+
+        double w = total_weight ? ri.weight / total_weight : 0;
+        double kilo_ins = ri.icount / 1000.0;
+        if (kilo_ins)
+        {
+            FOREACH_LOAD_TYPE_SIZE({
+                weighted_load_pki[type][size] += w * ri.load_count[type][size] / kilo_ins;
+                weighted_stable_loads_pki[type][size] += w * num_stable_loads[type][size] / kilo_ins;
+            });
+            weighted_load_pki_total += w * total_loads / kilo_ins;
+            weighted_stable_loads_pki_total += w * total_stable_loads / kilo_ins;
+        }
+        if (total_loads)
+            weighted_stable_loads_fraction += w * total_stable_loads / total_loads;
+        if (num_load_ips)
+            weighted_stable_load_ips_fraction += w * total_stable_load_ips / num_load_ips;
+        projected_loads += ri.multiplier * total_loads;
+        projected_stable_loads += ri.multiplier * total_stable_loads;
+    }
+
+    stats << "weighted.regions " << region_infos.size() << std::endl;
+    stats << "weighted.weight_total " << total_weight << std::endl;
+    stats << "weighted.load_pki.total " << weighted_load_pki_total << std::endl;
+    FOREACH_LOAD_TYPE_SIZE({
+        stats << "weighted.load_pki." << load_type_t2str[type] << "." << load_size2str[size] << " " << weighted_load_pki[type][size] << std::endl;
+    });
+    stats << "weighted.global_stable_loads_pki.total " << weighted_stable_loads_pki_total << std::endl;
+    FOREACH_LOAD_TYPE_SIZE({
+        stats << "weighted.global_stable_loads_pki." << load_type_t2str[type] << "." << load_size2str[size] << " " << weighted_stable_loads_pki[type][size] << std::endl;
+    });
+    stats << "weighted.global_stable_loads.fraction " << weighted_stable_loads_fraction << std::endl;
+    stats << "weighted.global_stable_load_ips.fraction " << weighted_stable_load_ips_fraction << std::endl;
+    stats << "projected.load.total " << (uint64_t)projected_loads << std::endl;
+    stats << "projected.global_stable_loads.total " << (uint64_t)projected_stable_loads << std::endl;
+
+    stats.close();
+}
+
+#endif
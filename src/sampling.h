@@ -0,0 +1,139 @@
+/**********************************************************
+ * Bursty sampling of Load Inspector
+ * Loads are only instrumented during windows of X out of
+ * every Y instructions of each thread. Traces come in two
+ * versions, with and without load instrumentation, and a
+ * tool register selects the version a thread runs.
+ **********************************************************/
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+#include "stats.h"
+
+typedef enum
+{
+    SAMPLE_OFF = 0,     // default trace version
+    SAMPLE_ON,
+    NUM_SAMPLE_VERSIONS
+} sample_version_t;
+
+static uint64_t sample_length = 0;  // zero disables sampling
+static uint64_t sample_period = 0;
+static REG sample_reg;              // sample_version_t the thread should run
+
+// Returns FALSE if no tool register is left
+static BOOL init_sampling(uint64_t length, uint64_t period)
+{
+    sample_length = length;
+    sample_period = period;
+    sample_reg = PIN_ClaimToolRegister();
+    return REG_valid(sample_reg);
+}
+
+// Closes the open window of a thread, if any
+static void close_sample_window(thread_stats_t* ts, THREADID tid)
+{
+    if (ts->sampling)
+        ts->sampled_icount += thread_ins_counter_inside_roi[tid]._count - ts->sample_start_icount;
+    ts->sampling = FALSE;
+}
+
+static void open_sample_window(thread_stats_t* ts, THREADID tid)
+{
+    ts->sampling = TRUE;
+    ts->sample_window++;
+    ts->sample_start_icount = thread_ins_counter_inside_roi[tid]._count;
+}
+
+// Every thread starts with a window
+static void start_sampling(THREADID tid, CONTEXT* ctxt)
+{
+    thread_stats_t* ts = thread_stats[tid];
+    close_sample_window(ts, tid);
+    open_sample_window(ts, tid);
+    ts->next_sample_toggle = thread_ins_counter[tid]._count + sample_length;
+    PIN_SetContextReg(ctxt, sample_reg, SAMPLE_ON);
+}
+
+// Called once a thread's icount crosses the end of its window or
+// of the gap after it; returns the version to run from now on
+static ADDRINT sample_toggle(THREADID tid)
+{
+    thread_stats_t* ts = thread_stats[tid];
+    if (ts->sampling)
+    {
+        close_sample_window(ts, tid);
+        ts->next_sample_toggle += sample_period - sample_length;
+        return SAMPLE_OFF;
+    }
+
+    open_sample_window(ts, tid);
+    ts->next_sample_toggle += sample_length;
+    return SAMPLE_ON;
+}
+
+//-------------------------------//
+// Appends the sampling stats; must run after dump_stats.
+// Load counts are extrapolated by the sampled share of the
+// ROI instructions. A global-stable IP is confirmed if it
+// repeated across windows, not only within one; windows are
+// numbered per thread, and the n-th windows of all threads
+// count as the same window.
+//-------------------------------//
+static void dump_sampling_stats(std::string stats_filename)
+{
+    uint64_t sampled_icount = 0, windows = 0;
+    for (uint32_t tid = 0; tid < PIN_MAX_THREADS; ++tid)
+    {
+        thread_stats_t* ts = thread_stats[tid];
+        if (!ts)
+            continue;
+        close_sample_window(ts, tid);
+        sampled_icount += ts->sampled_icount;
+        windows += ts->sample_window;
+    }
+
+    uint64_t icount = sum_thread_counters(thread_ins_counter_inside_roi);
+    double ratio = icount ? (double)sampled_icount / icount : 0.0;
+
+    uint64_t confirmed_ips = 0, single_window_ips = 0;
+    for (uint32_t slot = 0; slot < load_slots.size(); ++slot)
+    {
+        const load_slot_t& ls = load_slots[slot];
+        if (ls.unstable || ls.occur <= 1)
+            continue;
+        if (ls.multi_window)
+            confirmed_ips++;
+        else
+            single_window_ips++;
+    }
+
+    std::ofstream stats;
+    stats.open(stats_filename.c_str(), std::ios::app);
+
+    stats << std::endl;
+    stats << "sample.window " << sample_length << std::endl;
+    stats << "sample.period " << sample_period << std::endl;
+    stats << "sample.windows " << windows << std::endl;
+    stats << "sample.icount " << sampled_icount << std::endl;
+    stats << "sample.ratio " << std::fixed << std::setprecision(6) << ratio << std::endl;
+    stats.unsetf(std::ios::floatfield);
+
+    uint64_t total_loads = 0;
+    FOREACH_LOAD_TYPE_SIZE({
+        total_loads += load_count[type][size];
+    });
+    stats << "sample.load.extrapolated.total " << (uint64_t)(ratio ? total_loads / ratio : 0) << std::endl;
+    FOREACH_LOAD_TYPE_SIZE({
+        stats << "sample.load.extrapolated." << load_type_t2str[type] << "." << load_size2str[size]
+              << " " << (uint64_t)(ratio ? load_count[type][size] / ratio : 0) << std::endl;
+    });
+
+    stats << "sample.global_stable_load_ips.confirmed " << confirmed_ips << std::endl;
+    stats << "sample.global_stable_load_ips.single_window " << single_window_ips << std::endl;
+
+    stats.close();
+}
+
+#endif
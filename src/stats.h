@@ -6,10 +6,16 @@
 #ifndef STATS_H
 #define STATS_H
 
-#include <unordered_map>
-#include <unordered_set>
+#include <map>
+#include <vector>
 #include <iomanip>
 #include "ialarm.H"
+#include "memory.h"
+#include "store_tracker.h"
+#include "profile_format.h"
+#include "images.h"
+#include "symbols.h"
+#include "overhead.h"
 
 
 typedef enum
@@ -17,14 +23,20 @@ typedef enum
     RIP_LOAD = 0,
     STACK_LOAD,
     REG_LOAD,
+    GATHER_LOAD,    // an element of a gather or other multi-reference load
     NUM_LOAD_TYPES
 } load_type_t;
 
-std::string load_type_t2str[] = { "RIP", "STACK", "REG" };
+std::string load_type_t2str[] = { "RIP", "STACK", "REG", "GATHER" };
 
 const uint32_t NUM_LOAD_SIZES = 8;
 std::string load_size2str[] = { "1B", "2B", "4B", "8B", "16B", "32B", "64B", "UNCATEGORIZED" };
 
+// Size buckets whose addr/value stability is tracked (1B-64B),
+// of which the first ones hold their value inline in the slot (1B-8B)
+const uint32_t NUM_TRACKED_LOAD_SIZES = 7;
+const uint32_t NUM_SCALAR_LOAD_SIZES = 4;
+
 #define FOREACH_LOAD_TYPE_SIZE(body)                                \
     do                                                              \
     {                                                               \
@@ -33,36 +45,417 @@ std::string load_size2str[] = { "1B", "2B", "4B", "8B", "16B", "32B", "64B", "UN
                 body;                                               \
     } while (0)
 
+//-------------------------------//
+// State of one static load slot
+// Every static load IP gets a dense slot id when it is instrumented.
+// The analysis routines index a flat array of these (two per cache line)
+// instead of hashing the IP on every dynamic load.
+//-------------------------------//
 typedef struct
 {
-    load_type_t load_type;
     uint64_t addr = 0xdeadbeef;
-    uint64_t val = 0x0;
-    uint32_t sizeb = 0;
-    uint64_t occur = 0;
-} load_attr_t;
+    uint64_t val = 0x0;     // value, or vector_values index for vector loads
+    uint64_t occur = 0;     // dynamic executions; zero until first observed
+    uint8_t load_type = 0;
+    uint8_t sizeb = 0;
+    uint8_t unstable = 0;
+    uint8_t multi_window = 0;   // repeated across sampling windows
+    uint32_t window = 0;        // sampling window of the first execution
+} load_slot_t;
+
+// Values of vector loads (16B-64B) live in a per-thread side pool,
+// so the scalar slots keep their compact layout.
+// Bytes beyond the load size are kept zero.
+typedef struct
+{
+    uint64_t w[8];
+} vector_value_t;
+
+
+// Value locality of one static load slot (-locality), in a per-thread
+// side array parallel to the slots. Fixed size, so tracking it costs
+// the same per load whatever the load does.
+typedef struct
+{
+    uint64_t last_addr = 0;
+    uint64_t last_val = 0;      // value, or a fold of it for vector loads
+    uint64_t value_hits = 0;    // executions that loaded the previous value
+    uint64_t stride_hits = 0;   // executions that repeated the previous address stride
+    int32_t last_stride = 0;    // LOCALITY_NO_STRIDE if it does not fit
+    uint8_t addr_changed = 0;
+    uint8_t val_changed = 0;
+} locality_state_t;
+
+const int32_t LOCALITY_NO_STRIDE = INT32_MIN;
 
 
 //-------------------------------//
 // Stats used in the tool
 //-------------------------------//
-static CACHELINE_COUNTER global_ins_counter = {0, 0};
-static CACHELINE_COUNTER global_ins_counter_inside_roi = {0, 0};
+// One padded counter per thread, so docount never bounces a shared line
+static CACHELINE_COUNTER thread_ins_counter[PIN_MAX_THREADS];
+static CACHELINE_COUNTER thread_ins_counter_inside_roi[PIN_MAX_THREADS];
 static uint64_t agen_icount = 0;
 static uint64_t load_count[NUM_LOAD_TYPES][NUM_LOAD_SIZES]= {};
-static std::unordered_map<uint64_t, load_attr_t> load_addr_val_map;
-static std::unordered_set<uint64_t> load_ip_known_unstable;
+static std::vector<load_slot_t> load_slots; // merged across threads at fini
+static std::vector<const vector_value_t*> load_slot_vector_values; // merged values of stable vector slots
+static std::vector<locality_state_t> load_locality; // merged with -locality
+static BOOL locality_tables = FALSE; // shards keep locality tables (-locality)
+
+static uint64_t pruned_load_ips = 0;
+static uint64_t repeated_load_ips = 0;  // first seen repeating, once over all threads
+static uint64_t prune_invalidations = 0;    // batches of IPs removed from the code cache
+static uint64_t prune_invalidated_ips = 0;
+
+//-------------------------------//
+// Static load slot registry
+// Grows at instrumentation time; guarded by load_slot_lock since
+// the analysis routines mark slots pruned concurrently.
+//-------------------------------//
+static PIN_LOCK load_slot_lock;
+static compact_ip_table load_ip2slot;
+static std::vector<uint64_t> load_slot_ip;
+static std::vector<uint8_t> load_slot_pruned; // known unstable, instrumented count-only
+const uint8_t SLOT_PRUNED = 1;
+const uint8_t SLOT_UNTRACKED = 2;   // also pruned as some thread could not track it
+static std::vector<uint8_t> load_slot_repeated; // seen repeating by some thread
+static std::vector<uint8_t> load_slot_element; // element of a multi-reference load, else 0
+static std::vector<uint32_t> load_slot_epoch; // image epoch the IP was first instrumented in
+static volatile uint32_t num_load_slots = 0;
+
+// Multi-reference loads (gathers, tile loads) get one slot per element,
+// consecutive from the IP's slot; later elements share the last one
+const uint32_t MAX_LOAD_ELEMENTS = 16;
+
+// Load IPs refused once the tables reached -max_table_mb; they are
+// instrumented count-only without a slot
+const uint32_t UNTRACKED_SLOT = ~0u;
+static uint64_t untracked_load_ips = 0;
+static std::vector<uint64_t> untracked_ip_filter; // dedups re-instrumented IPs, approximately
+static uint64_t untracked_loads = 0; // merged from the shards
+
+const uint32_t NO_REGION = ~0u;
+
+// Direct-mapped, per thread; see untrack_thread_load
+const uint32_t UNTRACKED_MEMO = 256;
+
+//-------------------------------//
+// Per-thread shards of the stats
+// Each application thread only ever touches its own shard,
+// so the analysis routines need no locking.
+// Shards are merged into the globals above at fini.
+//-------------------------------//
+typedef struct
+{
+    uint64_t agen_icount = 0;
+    uint64_t next_interval_check = 0;   // own icount of the next snapshot check
+    uint64_t next_sample_toggle = 0;    // own icount of the next sampling window start/end
+    uint64_t sample_start_icount = 0;   // ROI icount at the start of the open window
+    uint64_t sampled_icount = 0;        // ROI instructions executed inside windows
+    uint32_t sample_window = 0;         // windows opened so far; the id of the current one
+    BOOL sampling = FALSE;
+    uint32_t region = NO_REGION;        // PC region being profiled, or NO_REGION
+    uint64_t region_start_icount = 0;   // ROI icount when it started
+    uint64_t region_start_load_count[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {};
+    uint64_t load_count[NUM_LOAD_TYPES][NUM_LOAD_SIZES] = {};
+    uint64_t untracked_loads = 0;       // loads of IPs without a slot
+    uint64_t untracked_slot_loads = 0;  // loads of slots the shard could not hold; counted
+                                        // by the analysis, which -buffered runs on a worker
+    uint32_t untracked_memo[UNTRACKED_MEMO] = {}; // slot + 1 of slots this thread already left untracked
+    overhead_t overhead;                // only with -overhead
+    chunked_table<load_slot_t, MEM_SLOTS> slots;
+    chunked_table<vector_value_t, MEM_VECTOR_VALUES> vector_values;
+    chunked_table<locality_state_t, MEM_LOCALITY> locality; // only with -locality
+} thread_stats_t;
+
+static thread_stats_t* thread_stats[PIN_MAX_THREADS] = {};
+static volatile uint32_t num_thread_ids = 0; // highest thread id seen + 1
+
+// Slot tables of each thread per PC region, by region id.
+// A thread's tables for the region it is in live in its shard above,
+// the entry here is a placeholder until it leaves (see regions.h).
+static std::map<uint32_t, std::vector<thread_stats_t*>> region_shards;
+
+// Sums a per-thread counter. Safe to call while threads are running,
+// the result is then a slightly stale snapshot.
+static uint64_t sum_thread_counters(const CACHELINE_COUNTER* counters)
+{
+    uint64_t total = 0;
+    for (uint32_t tid = 0; tid < num_thread_ids; ++tid)
+        total += counters[tid]._count;
+    return total;
+}
+
+//-------------------------------//
+// Whether admitting the given number of slots keeps the tables under the cap
+// Besides what is allocated, every running thread's shard must be
+// able to grow to cover all slots, and to add a chunk of vector
+// values. Threads that start later, and shards of PC regions, are
+// not foreseen here; grow_thread_slots holds them to the cap.
+// Called under load_slot_lock.
+//-------------------------------//
+static BOOL slot_fits_mem_cap(uint32_t num_slots)
+{
+    if (!mem_cap)
+        return TRUE;
+
+    uint64_t chunks = ((uint64_t)num_load_slots + num_slots + TABLE_CHUNK - 1) >> TABLE_CHUNK_SHIFT;
+    uint64_t projected = mem_table_total() + load_ip2slot.grow_bytes()
+                         + (load_slot_ip.size() + num_slots) * (sizeof(uint64_t) + sizeof(uint32_t) + 3 * sizeof(uint8_t));
+    for (uint32_t tid = 0; tid < num_thread_ids; ++tid)
+    {
+        const thread_stats_t* ts = thread_stats[tid];
+        if (!ts)
+            continue;
+        if (chunks > ts->slots.num_chunks())
+            projected += (chunks - ts->slots.num_chunks()) * TABLE_CHUNK * sizeof(load_slot_t);
+        if (locality_tables && chunks > ts->locality.num_chunks())
+            projected += (chunks - ts->locality.num_chunks()) * TABLE_CHUNK * sizeof(locality_state_t);
+        projected += TABLE_CHUNK * sizeof(vector_value_t);
+    }
+    return projected <= mem_cap;
+}
+
+static void note_untracked_ip(uint64_t ip)
+{
+    const uint64_t FILTER_BITS = 1 << 20;
+    if (untracked_ip_filter.empty())
+        untracked_ip_filter.assign(FILTER_BITS / 64, 0);
+
+    uint64_t bit = (ip * 0x9e3779b97f4a7c15ULL) >> 44;
+    uint64_t& word = untracked_ip_filter[bit / 64];
+    if (!(word & (1ULL << (bit % 64))))
+        untracked_load_ips++;
+    word |= 1ULL << (bit % 64);
+}
+
+// Returns the (first) slot of a load IP, or UNTRACKED_SLOT if new
+// ones would not fit; a multi-reference load IP takes one slot per
+// element. An IP reused by code of another shape (JIT-ed or reloaded
+// code) is untracked in that shape, as its slots are laid out for
+// the first one. Called under load_slot_lock.
+static uint32_t get_load_slot(uint64_t ip, uint32_t num_elements = 0)
+{
+    uint32_t num_slots = std::max(num_elements, 1u);
+    uint32_t ip_slots = 0;
+    uint32_t slot = load_ip2slot.find(ip, &ip_slots);
+    if (slot != compact_ip_table::NOT_FOUND && ip_slots == num_slots)
+        return slot;
+
+    if (slot != compact_ip_table::NOT_FOUND || !slot_fits_mem_cap(num_slots))
+    {
+        note_untracked_ip(ip);
+        return UNTRACKED_SLOT;
+    }
+
+    slot = load_slot_ip.size();
+    for (uint32_t element = 0; element < num_slots; element++)
+    {
+        load_slot_ip.push_back(ip);
+        load_slot_pruned.push_back(0);
+        load_slot_repeated.push_back(0);
+        load_slot_element.push_back(element);
+        load_slot_epoch.push_back(image_epoch);
+    }
+    load_ip2slot.insert(ip, slot, num_slots);
+    num_load_slots = slot + num_slots;
+    return slot;
+}
+
+//-------------------------------//
+// Grows a shard's slot (and locality) tables to cover all slots,
+// unless the new chunks would take the tables past -max_table_mb.
+// The total is read without arena_lock; threads growing at the
+// same time may each see it stale, by at most a chunk per table.
+//-------------------------------//
+static BOOL grow_thread_slots(thread_stats_t* ts)
+{
+    uint32_t num_slots = num_load_slots;
+    if (mem_cap)
+    {
+        uint64_t chunks = ((uint64_t)num_slots + TABLE_CHUNK - 1) >> TABLE_CHUNK_SHIFT;
+        uint64_t bytes = 0;
+        if (chunks > ts->slots.num_chunks())
+            bytes += (chunks - ts->slots.num_chunks()) * TABLE_CHUNK * sizeof(load_slot_t);
+        if (locality_tables && chunks > ts->locality.num_chunks())
+            bytes += (chunks - ts->locality.num_chunks()) * TABLE_CHUNK * sizeof(locality_state_t);
+        if (mem_table_total() + bytes > mem_cap)
+            return FALSE;
+    }
+    ts->slots.resize(num_slots);
+    if (locality_tables)
+        ts->locality.resize(num_slots);
+    return TRUE;
+}
+
+// Returns the shard's state of a slot, growing the shard to cover
+// slots instrumented since it was last touched; NULL if it may not
+// grow (see grow_thread_slots)
+static inline load_slot_t* thread_load_slot(thread_stats_t* ts, uint32_t slot)
+{
+    if (slot >= ts->slots.size() && !grow_thread_slots(ts))
+        return NULL;
+    return &ts->slots[slot];
+}
+
+
+// Every shard, in thread-id order and then by region and thread id,
+// so merges are deterministic
+static std::vector<thread_stats_t*> all_thread_shards()
+{
+    std::vector<thread_stats_t*> shards;
+    for (uint32_t tid = 0; tid < PIN_MAX_THREADS; ++tid)
+        if (thread_stats[tid])
+            shards.push_back(thread_stats[tid]);
+    for (auto it = region_shards.begin(); it != region_shards.end(); ++it)
+        for (auto sit = it->second.begin(); sit != it->second.end(); ++sit)
+            if (*sit)
+                shards.push_back(*sit);
+    return shards;
+}
+
+//-------------------------------//
+// Merges the given shards into the globals above
+// A load IP is global-stable only if it is stable in every shard
+// and all shards saw the same addr/value.
+//-------------------------------//
+static void merge_thread_stats(const std::vector<thread_stats_t*>& shards)
+{
+    agen_icount = 0;
+    untracked_loads = 0;
+    memset(load_count, 0, sizeof(load_count));
+    load_slots.assign(num_load_slots, load_slot_t());
+    load_slot_vector_values.assign(num_load_slots, NULL);
+    load_locality.assign(num_load_slots, locality_state_t());
+
+    for (auto it = shards.begin(); it != shards.end(); ++it)
+    {
+        thread_stats_t* ts = *it;
+
+        agen_icount += ts->agen_icount;
+        untracked_loads += ts->untracked_loads + ts->untracked_slot_loads;
+        FOREACH_LOAD_TYPE_SIZE({
+            load_count[type][size] += ts->load_count[type][size];
+        });
+
+        for (uint32_t slot = 0; slot < ts->slots.size(); ++slot)
+        {
+            const load_slot_t& tls = ts->slots[slot];
+            load_slot_t& gls = load_slots[slot];
+
+            if (!tls.occur)
+                continue;
+
+            const vector_value_t* vval = (tls.sizeb >= NUM_SCALAR_LOAD_SIZES && !tls.unstable) ?
+                                         &ts->vector_values[tls.val] : NULL;
+
+            const locality_state_t* tlc = (slot < ts->locality.size()) ? &ts->locality[slot] : NULL;
+            locality_state_t& glc = load_locality[slot];
+
+            if (!gls.occur)
+            {
+                gls = tls;
+                load_slot_vector_values[slot] = vval;
+                if (tlc)
+                    glc = *tlc;
+                continue;
+            }
+
+            if (tlc)
+            {
+                glc.value_hits += tlc->value_hits;
+                glc.stride_hits += tlc->stride_hits;
+                // the merged state changed unless every shard kept its first
+                // observation, and those agree; a shard that never changed
+                // its address (value) still holds the first one as its last
+                if (!glc.addr_changed && !tlc->addr_changed)
+                    glc.addr_changed = (glc.last_addr != tlc->last_addr);
+                else
+                    glc.addr_changed = 1;
+                if (!glc.val_changed && !tlc->val_changed)
+                    glc.val_changed = (glc.last_val != tlc->last_val);
+                else
+                    glc.val_changed = 1;
+            }
+
+            if (!gls.unstable)
+            {
+                BOOL same = !tls.unstable && gls.addr == tls.addr && gls.sizeb == tls.sizeb;
+                if (same)
+                    same = vval ? !memcmp(vval, load_slot_vector_values[slot], sizeof(vector_value_t))
+                                : gls.val == tls.val;
+                gls.unstable = !same;
+            }
+            gls.occur += tls.occur;
+            // the n-th windows of all threads count as one window
+            gls.multi_window |= tls.multi_window | (gls.window != tls.window);
+        }
+    }
+
+    // slots some thread could not track are pruned without being
+    // unstable in any shard
+    for (uint32_t slot = 0; slot < num_load_slots; ++slot)
+        if (load_slot_pruned[slot] & SLOT_UNTRACKED)
+            load_slots[slot].unstable = 1;
+}
+
+
+//-------------------------------//
+// Dumps the footprint of the tables
+// Entries of the per-thread tables are summed over every shard.
+// Store candidates live in node-based maps; their bytes are an
+// estimate.
+//-------------------------------//
+static void dump_memory_stats(std::ofstream& stats, bool track_stores)
+{
+    uint64_t table_entries[NUM_MEM_TABLES] = {};
+    table_entries[MEM_IP_TABLE] = load_ip2slot.size();
+    std::vector<thread_stats_t*> shards = all_thread_shards();
+    for (auto it = shards.begin(); it != shards.end(); ++it)
+    {
+        table_entries[MEM_SLOTS] += (*it)->slots.size();
+        table_entries[MEM_VECTOR_VALUES] += (*it)->vector_values.size();
+        table_entries[MEM_LOCALITY] += (*it)->locality.size();
+    }
+
+    stats << "mem.cap_bytes " << mem_cap << std::endl;
+    for (uint32_t table = 0; table < NUM_MEM_TABLES; ++table)
+    {
+        stats << "mem." << mem_table_t2str[table] << ".entries " << table_entries[table] << std::endl;
+        stats << "mem." << mem_table_t2str[table] << ".bytes " << mem_table_bytes[table] << std::endl;
+    }
+    stats << "mem.registry.entries " << load_slot_ip.size() << std::endl;
+    stats << "mem.registry.bytes "
+          << load_slot_ip.capacity() * sizeof(uint64_t) + load_slot_pruned.capacity() + load_slot_repeated.capacity()
+             + load_slot_element.capacity() + load_slot_epoch.capacity() * sizeof(uint32_t) << std::endl;
+    if (track_stores)
+    {
+        stats << "mem.store_candidates.entries " << store_candidates.size() << std::endl;
+        stats << "mem.store_candidates.bytes "
+              << store_candidates.size() * (sizeof(store_candidate_t) + 4 * sizeof(void*)) << std::endl;
+    }
+    stats << "mem.tables.bytes " << mem_table_total() << std::endl;
+    stats << "mem.tables.peak_bytes " << mem_table_peak << std::endl;
+    stats << "mem.arena.bytes " << arena_bytes << std::endl;
+    stats << "mem.untracked_load_ips " << untracked_load_ips << std::endl;
+    stats << "mem.untracked_loads " << untracked_loads << std::endl;
+    stats << "mem.rss_bytes " << read_proc_status_bytes("VmRSS") << std::endl;
+    stats << "mem.peak_rss_bytes " << read_proc_status_bytes("VmHWM") << std::endl;
+}
 
 
 //-------------------------------//
 // Dumps all the stats
 //-------------------------------//
-static void dump_stats(std::string stats_filename, bool dump_stable_loads, std::string stable_load_stats_filename)
+static void dump_stats(std::string stats_filename, bool dump_stable_loads, std::string stable_load_stats_filename,
+                       bool track_stores)
 {
+    merge_thread_stats(all_thread_shards());
+
     std::ofstream stats;
     stats.open(stats_filename.c_str());
 
-    std::vector<std::pair<uint64_t, load_attr_t>> pairs;
+    std::vector<uint32_t> stable_slots;
 
     uint64_t total_loads = 0, total_loads_nv = 0, total_loads_v = 0;
     FOREACH_LOAD_TYPE_SIZE({
@@ -73,9 +466,24 @@ static void dump_stats(std::string stats_filename, bool dump_stable_loads, std::
             total_loads_nv += load_count[type][size];
     });
 
-    stats << "icount.total " << global_ins_counter._count << std::endl;
-    stats << "icount.inside_roi " << global_ins_counter_inside_roi._count << std::endl;
+    stats << "icount.total " << sum_thread_counters(thread_ins_counter) << std::endl;
+    stats << "icount.inside_roi " << sum_thread_counters(thread_ins_counter_inside_roi) << std::endl;
     stats << "icount.agen " << agen_icount << std::endl;
+    for (uint32_t tid = 0; tid < PIN_MAX_THREADS; ++tid)
+    {
+        if (!thread_stats[tid])
+            continue;
+        stats << "icount.thread." << tid << " " << thread_ins_counter[tid]._count << std::endl;
+        stats << "icount.inside_roi.thread." << tid << " " << thread_ins_counter_inside_roi[tid]._count << std::endl;
+    }
+    stats << std::endl;
+
+    stats << "prune.unstable_ips " << pruned_load_ips << std::endl;
+    stats << "prune.invalidations " << prune_invalidations << std::endl;
+    stats << "prune.invalidated_ips " << prune_invalidated_ips << std::endl;
+    stats << std::endl;
+
+    dump_memory_stats(stats, track_stores);
     stats << std::endl;
 
     stats << "load.total " << total_loads << std::endl;
@@ -92,20 +500,24 @@ static void dump_stats(std::string stats_filename, bool dump_stable_loads, std::
              total_stable_load_ips = 0,
              total_stable_loads = 0;
     
-    num_load_ips = load_ip_known_unstable.size() + load_addr_val_map.size();
-
-    for (auto it = load_addr_val_map.begin(); it != load_addr_val_map.end(); ++it)
+    for (uint32_t slot = 0; slot < load_slots.size(); ++slot)
     {
-        if (it->second.occur > 1)
+        const load_slot_t& ls = load_slots[slot];
+        if (!ls.occur)
+            continue;
+
+        num_load_ips++;
+
+        if (!ls.unstable && ls.occur > 1)
         {
-            num_stable_load_ips[it->second.load_type][it->second.sizeb]++;
+            num_stable_load_ips[ls.load_type][ls.sizeb]++;
             total_stable_load_ips++;
 
-            num_stable_loads[it->second.load_type][it->second.sizeb] += it->second.occur;
-            total_stable_loads += it->second.occur;
+            num_stable_loads[ls.load_type][ls.sizeb] += ls.occur;
+            total_stable_loads += ls.occur;
             
             if (dump_stable_loads)
-                pairs.push_back(*it);
+                stable_slots.push_back(slot);
         }
     }
 
@@ -121,6 +533,23 @@ static void dump_stats(std::string stats_filename, bool dump_stable_loads, std::
         stats << "global_stable_loads." << load_type_t2str[type] << "." << load_size2str[size] << " " << num_stable_loads[type][size] << std::endl;
     });
 
+    if (track_stores)
+    {
+        uint64_t num_store_class_ips[NUM_STORE_CLASSES] = {};
+        for (uint32_t slot = 0; slot < load_slots.size(); ++slot)
+        {
+            const load_slot_t& ls = load_slots[slot];
+            if (!ls.unstable && ls.occur > 1)
+                num_store_class_ips[get_store_class(find_store_candidate(slot))]++;
+        }
+
+        stats << std::endl;
+        stats << "store.filter_hits " << stores_filtered << std::endl;
+        stats << "store.candidate_hits " << stores_matched << std::endl;
+        for (uint32_t sclass = 0; sclass < NUM_STORE_CLASSES; ++sclass)
+            stats << "global_stable_load_ips." << store_class_t2str[sclass] << " " << num_store_class_ips[sclass] << std::endl;
+    }
+
     stats.close();
 
     if(dump_stable_loads)
@@ -128,17 +557,44 @@ static void dump_stats(std::string stats_filename, bool dump_stable_loads, std::
         std::ofstream sl_stats;
         sl_stats.open(stable_load_stats_filename.c_str());
 
-        sl_stats << "global_stable_load_ip,occurence,load_type" << std::endl;
-        std::sort(pairs.begin(), pairs.end(),
-                [](std::pair<uint64_t, load_attr_t> &a, std::pair<uint64_t, load_attr_t> &b)
+        sl_stats << "global_stable_load_ip,image,offset,routine,source,occurence,load_type,element";
+        if (track_stores)
+            sl_stats << ",store_class,silent_stores,invalidating_stores";
+        sl_stats << std::endl;
+        std::sort(stable_slots.begin(), stable_slots.end(),
+                [](uint32_t a, uint32_t b)
                 {
-                    return a.second.occur > b.second.occur;
+                    return load_slots[a].occur > load_slots[b].occur;
                 });
-        for (auto it = pairs.begin(); it != pairs.end(); ++it)
+
+        // IPs of images still loaded were not symbolized at unload
+        sort_image_ranges();
+        std::vector<uint64_t> ips;
+        for (auto it = stable_slots.begin(); it != stable_slots.end(); ++it)
+            ips.push_back(load_slot_ip[*it]);
+        symbolize_ips(ips);
+
+        for (auto it = stable_slots.begin(); it != stable_slots.end(); ++it)
         {
-            sl_stats << "0x" << std::hex << it->first
-                << "," << std::dec << it->second.occur 
-                << "," << load_type_t2str[it->second.load_type] << std::endl;
+            uint64_t ip = load_slot_ip[*it];
+            int32_t image = find_image(ip, load_slot_epoch[*it]);
+            const load_symbol_t& sym = load_symbols[ip];
+            sl_stats << "0x" << std::hex << ip
+                << "," << csv_field(image < 0 ? LOAD_PROFILE_ANON_IMAGE : image_ranges[image].name)
+                << ",0x" << (image < 0 ? ip : ip - image_ranges[image].low)
+                << "," << csv_field(sym.routine)
+                << "," << csv_field(load_symbol_source(sym))
+                << "," << std::dec << load_slots[*it].occur 
+                << "," << load_type_t2str[load_slots[*it].load_type]
+                << "," << (uint32_t)load_slot_element[*it];
+            if (track_stores)
+            {
+                const store_candidate_t& sc = find_store_candidate(*it);
+                sl_stats << "," << store_class_t2str[get_store_class(sc)]
+                    << "," << sc.silent_stores
+                    << "," << sc.invalidating_stores;
+            }
+            sl_stats << std::endl;
         }
 
         sl_stats.close();
@@ -146,5 +602,89 @@ static void dump_stats(std::string stats_filename, bool dump_stable_loads, std::
 }
 
 
-#endif
+//-------------------------------//
+// Dumps every observed load IP as a binary profile
+// (see profile_format.h); must run after dump_stats.
+// IPs are stored with the image they belong to, so profiles
+// of different runs can be merged despite ASLR.
+//-------------------------------//
+static void dump_load_profile(std::string profile_filename)
+{
+    sort_image_ranges();
+
+    // the anonymous image goes last
+    uint32_t anon_image = image_ranges.size();
+    std::vector<load_profile_record_t> records;
 
+    for (uint32_t slot = 0; slot < load_slots.size(); ++slot)
+    {
+        const load_slot_t& ls = load_slots[slot];
+        if (!ls.occur)
+            continue;
+
+        load_profile_record_t rec = {};
+        rec.ip = load_slot_ip[slot];
+        rec.count = ls.occur;
+        rec.load_type = ls.load_type;
+        rec.sizeb = ls.sizeb;
+        rec.element = load_slot_element[slot];
+        rec.state = ls.unstable ? PROFILE_UNSTABLE : (ls.occur > 1 ? PROFILE_STABLE : PROFILE_SEEN_ONCE);
+        if (!ls.unstable)
+        {
+            rec.addr = ls.addr;
+            rec.val = load_slot_vector_values[slot] ?
+                      load_profile_hash_value(load_slot_vector_values[slot], 1 << ls.sizeb) : ls.val;
+        }
+        int32_t image = find_image(rec.ip, load_slot_epoch[slot]);
+        rec.image = (image < 0) ? anon_image : image;
+        records.push_back(rec);
+    }
+
+    std::sort(records.begin(), records.end(),
+            [](const load_profile_record_t &a, const load_profile_record_t &b)
+            {
+                if (a.image != b.image)
+                    return a.image < b.image;
+                return a.ip != b.ip ? a.ip < b.ip : a.element < b.element;
+            });
+
+    std::vector<load_profile_image_t> images(anon_image + 1);
+    std::string names;
+    for (uint32_t i = 0; i <= anon_image; ++i)
+    {
+        const std::string& name = (i == anon_image) ? LOAD_PROFILE_ANON_IMAGE : image_ranges[i].name;
+        images[i].low = (i == anon_image) ? 0 : image_ranges[i].low;
+        images[i].high = (i == anon_image) ? ~0ULL : image_ranges[i].high;
+        images[i].name_offset = names.size();
+        images[i].name_length = name.size();
+        names += name;
+    }
+    for (uint64_t r = 0; r < records.size(); ++r)
+    {
+        load_profile_image_t& image = images[records[r].image];
+        if (!image.num_records)
+            image.first_record = r;
+        image.num_records++;
+    }
+
+    load_profile_header_t header = {};
+    memcpy(header.magic, LOAD_PROFILE_MAGIC, sizeof(header.magic));
+    header.version = LOAD_PROFILE_VERSION;
+    header.record_size = sizeof(load_profile_record_t);
+    header.num_records = records.size();
+    header.icount = sum_thread_counters(thread_ins_counter);
+    header.icount_inside_roi = sum_thread_counters(thread_ins_counter_inside_roi);
+    header.num_images = images.size();
+    header.images_offset = sizeof(header) + records.size() * sizeof(load_profile_record_t);
+
+    std::ofstream profile;
+    profile.open(profile_filename.c_str(), std::ios::binary);
+    profile.write((const char*)&header, sizeof(header));
+    profile.write((const char*)records.data(), records.size() * sizeof(load_profile_record_t));
+    profile.write((const char*)images.data(), images.size() * sizeof(load_profile_image_t));
+    profile.write(names.data(), names.size());
+    profile.close();
+}
+
+
+#endif
@@ -0,0 +1,207 @@
+/**********************************************************
+ * Store-aware stability tracking of Load Inspector
+ * Records stores to the addresses of candidate stable
+ * loads, to tell loads that were never written apart from
+ * ones that were silently rewritten or invalidated.
+ **********************************************************/
+
+#ifndef STORE_TRACKER_H
+#define STORE_TRACKER_H
+
+#include <unordered_map>
+#include <vector>
+
+typedef enum
+{
+    NEVER_WRITTEN = 0,
+    SILENTLY_REWRITTEN,
+    INVALIDATED,
+    NUM_STORE_CLASSES
+} store_class_t;
+
+std::string store_class_t2str[] = { "never_written", "silently_rewritten", "invalidated" };
+
+//-------------------------------//
+// Coarse shadow filter of tracked addresses
+// One bit per hashed cache line. A clear bit proves no candidate
+// lives in that line, so most stores never take a lock or probe
+// the candidate index. Bits are never cleared; stale ones only
+// cost a slow-path lookup.
+//-------------------------------//
+const uint32_t STORE_SHADOW_LINE_BITS = 6;
+const uint32_t STORE_SHADOW_BITS = 1 << 23;
+static uint8_t store_shadow[STORE_SHADOW_BITS / 8];
+
+static inline uint32_t store_shadow_index(uint64_t addr)
+{
+    return (addr >> STORE_SHADOW_LINE_BITS) & (STORE_SHADOW_BITS - 1);
+}
+
+static inline BOOL store_shadow_test(uint64_t addr)
+{
+    uint32_t idx = store_shadow_index(addr);
+    return (store_shadow[idx >> 3] >> (idx & 7)) & 1;
+}
+
+//-------------------------------//
+// Candidate index
+// Holds the first observed addr/value of each load slot,
+// keyed by the cache lines it covers.
+//-------------------------------//
+typedef struct
+{
+    uint64_t addr = 0;
+    uint32_t size = 0;
+    uint64_t val[8] = {};
+    uint64_t silent_stores = 0;
+    uint64_t invalidating_stores = 0;
+} store_candidate_t;
+
+static PIN_LOCK store_lock;
+static std::unordered_map<uint32_t, store_candidate_t> store_candidates; // keyed by load slot
+static std::unordered_map<uint64_t, std::vector<uint32_t>> store_line_slots;
+static uint64_t stores_filtered = 0; // stores that passed the shadow filter
+static uint64_t stores_matched = 0;  // ...and overlapped a candidate
+
+static inline store_class_t get_store_class(const store_candidate_t& sc)
+{
+    return sc.invalidating_stores ? INVALIDATED : (sc.silent_stores ? SILENTLY_REWRITTEN : NEVER_WRITTEN);
+}
+
+// The candidate of a slot, for the stats at fini; a slot never
+// registered was never written
+static const store_candidate_t& find_store_candidate(uint32_t slot)
+{
+    static const store_candidate_t never_written = store_candidate_t();
+    auto it = store_candidates.find(slot);
+    return it != store_candidates.end() ? it->second : never_written;
+}
+
+// Registers the first observed addr/value of a load slot
+static void track_store_candidate(THREADID tid, uint32_t slot, uint64_t addr, uint32_t size, const void* val)
+{
+    PIN_GetLock(&store_lock, tid + 1);
+    if (store_candidates.find(slot) == store_candidates.end())
+    {
+        store_candidate_t& sc = store_candidates[slot];
+        sc.addr = addr;
+        sc.size = size;
+        memcpy(sc.val, val, size);
+
+        for (uint64_t line = addr >> STORE_SHADOW_LINE_BITS;
+             line <= (addr + size - 1) >> STORE_SHADOW_LINE_BITS; line++)
+        {
+            uint32_t idx = store_shadow_index(line << STORE_SHADOW_LINE_BITS);
+            store_shadow[idx >> 3] |= (1 << (idx & 7));
+            store_line_slots[line].push_back(slot);
+        }
+    }
+    PIN_ReleaseLock(&store_lock);
+}
+
+// Drops a slot known to be unstable; its store counts are kept
+static void untrack_store_candidate(THREADID tid, uint32_t slot)
+{
+    PIN_GetLock(&store_lock, tid + 1);
+    auto it = store_candidates.find(slot);
+    if (it != store_candidates.end())
+    {
+        for (uint64_t line = it->second.addr >> STORE_SHADOW_LINE_BITS;
+             line <= (it->second.addr + it->second.size - 1) >> STORE_SHADOW_LINE_BITS; line++)
+        {
+            std::vector<uint32_t>& slots = store_line_slots[line];
+            slots.erase(std::remove(slots.begin(), slots.end(), slot), slots.end());
+            if (slots.empty())
+                store_line_slots.erase(line);
+        }
+    }
+    PIN_ReleaseLock(&store_lock);
+}
+
+//-------------------------------//
+// Per-thread stores waiting to be checked
+// A store is filtered before it executes, and checked after it,
+// once the written value can be read back from memory.
+// The largest scatter writes 16 elements.
+//-------------------------------//
+const uint32_t MAX_PENDING_STORES = 16;
+
+typedef struct
+{
+    uint64_t ea[MAX_PENDING_STORES];
+    uint32_t size[MAX_PENDING_STORES];
+    uint32_t num;
+    uint8_t _pad[64];
+} store_pending_t;
+
+static store_pending_t store_pending[PIN_MAX_THREADS];
+
+static inline BOOL store_filter_hit(uint64_t ea, uint32_t size)
+{
+    return store_shadow_test(ea) | store_shadow_test(ea + size - 1);
+}
+
+// Compares every candidate overlapping the queued stores against the
+// current memory contents: unchanged means the store was silent
+static void check_queued_stores(THREADID tid)
+{
+    store_pending_t& sp = store_pending[tid];
+
+    PIN_GetLock(&store_lock, tid + 1);
+    for (uint32_t i = 0; i < sp.num; i++)
+    {
+        uint64_t ea = sp.ea[i];
+        uint64_t end = ea + sp.size[i];
+        stores_filtered++;
+
+        BOOL matched = FALSE;
+        uint64_t first_line = ea >> STORE_SHADOW_LINE_BITS;
+        for (uint64_t line = first_line; line <= (end - 1) >> STORE_SHADOW_LINE_BITS; line++)
+        {
+            auto lit = store_line_slots.find(line);
+            if (lit == store_line_slots.end())
+                continue;
+
+            for (auto sit = lit->second.begin(); sit != lit->second.end(); ++sit)
+            {
+                store_candidate_t& sc = store_candidates[*sit];
+
+                if (sc.addr + sc.size <= ea || sc.addr >= end)
+                    continue;
+
+                // a candidate spanning two lines the store also spans
+                // was already checked in the first one
+                if (line != first_line && (sc.addr >> STORE_SHADOW_LINE_BITS) != line)
+                    continue;
+
+                uint64_t cur[8] = {};
+                PIN_SafeCopy((void *)cur, (void *)sc.addr, sc.size);
+
+                if (!memcmp(cur, sc.val, sc.size))
+                    sc.silent_stores++;
+                else
+                    sc.invalidating_stores++;
+                matched = TRUE;
+            }
+        }
+        stores_matched += matched;
+    }
+    PIN_ReleaseLock(&store_lock);
+
+    sp.num = 0;
+}
+
+static inline void queue_store(THREADID tid, uint64_t ea, uint32_t size)
+{
+    store_pending_t& sp = store_pending[tid];
+
+    // queued stores have all executed by now
+    if (sp.num == MAX_PENDING_STORES)
+        check_queued_stores(tid);
+
+    sp.ea[sp.num] = ea;
+    sp.size[sp.num] = size;
+    sp.num++;
+}
+
+#endif
@@ -0,0 +1,79 @@
+/**********************************************************
+ * Symbolization of dumped load IPs
+ * Routine names and source locations are looked up in one
+ * batch per image, when the image is unloaded or at fini,
+ * and cached by IP; the analysis routines never see them.
+ **********************************************************/
+
+#ifndef SYMBOLS_H
+#define SYMBOLS_H
+
+#include <algorithm>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "csv.h"
+
+typedef struct
+{
+    std::string routine;    // empty if unknown
+    std::string file;       // empty without debug info
+    int32_t line = 0;
+} load_symbol_t;
+
+static std::unordered_map<uint64_t, load_symbol_t> load_symbols;
+
+//-------------------------------//
+// Resolves the IPs not yet in the cache
+// IPs are visited in address order, so consecutive IPs of the same
+// routine reuse its lookup. Needs the images to still be loaded.
+//-------------------------------//
+static void symbolize_ips(std::vector<uint64_t> ips)
+{
+    std::sort(ips.begin(), ips.end());
+
+    PIN_LockClient();
+    uint64_t rtn_low = 1, rtn_high = 0;
+    std::string rtn_name;
+    for (auto it = ips.begin(); it != ips.end(); ++it)
+    {
+        uint64_t ip = *it;
+        if (load_symbols.count(ip))
+            continue;
+
+        if (ip < rtn_low || ip >= rtn_high)
+        {
+            RTN rtn = RTN_FindByAddress(ip);
+            if (RTN_Valid(rtn))
+            {
+                rtn_low = RTN_Address(rtn);
+                rtn_high = rtn_low + RTN_Size(rtn);
+                rtn_name = RTN_Name(rtn);
+            }
+            else
+            {
+                rtn_low = 1;
+                rtn_high = 0;
+                rtn_name.clear();
+            }
+        }
+
+        load_symbol_t& sym = load_symbols[ip];
+        sym.routine = rtn_name;
+        INT32 column = 0, line = 0;
+        PIN_GetSourceLocation(ip, &column, &line, &sym.file);
+        sym.line = line;
+    }
+    PIN_UnlockClient();
+}
+
+// "file:line", or empty
+static std::string load_symbol_source(const load_symbol_t& sym)
+{
+    if (sym.file.empty())
+        return "";
+    return sym.file + ":" + std::to_string(sym.line);
+}
+
+#endif
@@ -0,0 +1,62 @@
+/*
+ * Gather-heavy code.
+ * Gathers need address generation per element, so the tool
+ * analyzes them through mem_agen rather than the standard
+ * memory operand path. Half of the indices are fixed, so some
+ * elements keep loading the same value.
+ * Built as gather.avx2 and gather.avx512.
+ *   gather [passes]
+ */
+# include <immintrin.h>
+# include <stdint.h>
+# include <stdio.h>
+# include <stdlib.h>
+
+# define N ( 1 << 16 )
+# define NIDX 4096
+
+static int32_t data[N];
+static int32_t idx[NIDX] __attribute__ ( ( aligned ( 64 ) ) );
+
+int main ( int argc, char *argv[] )
+{
+	long passes = argc > 1 ? atol ( argv[1] ) : 200;
+	long p;
+	int i;
+	int32_t out[16];
+	int64_t total = 0;
+
+	srand ( 1 );
+	for ( i = 0; i < N; i++ )
+		data[i] = i;
+	for ( i = 0; i < NIDX; i++ )
+		idx[i] = ( i & 1 ) ? rand ( ) % N : 0;
+
+	for ( p = 0; p < passes; p++ )
+	{
+#ifdef __AVX512F__
+		__m512i acc = _mm512_setzero_si512 ( );
+		for ( i = 0; i < NIDX; i += 16 )
+		{
+			__m512i vidx = _mm512_load_si512 ( ( const void * ) &idx[i] );
+			acc = _mm512_add_epi32 ( acc, _mm512_i32gather_epi32 ( vidx, data, 4 ) );
+		}
+		_mm512_storeu_si512 ( ( void * ) out, acc );
+		for ( i = 0; i < 16; i++ )
+			total += out[i];
+#else
+		__m256i acc = _mm256_setzero_si256 ( );
+		for ( i = 0; i < NIDX; i += 8 )
+		{
+			__m256i vidx = _mm256_load_si256 ( ( const __m256i * ) &idx[i] );
+			acc = _mm256_add_epi32 ( acc, _mm256_i32gather_epi32 ( data, vidx, 4 ) );
+		}
+		_mm256_storeu_si256 ( ( __m256i * ) out, acc );
+		for ( i = 0; i < 8; i++ )
+			total += out[i];
+#endif
+	}
+
+	printf ( "%lld\n", ( long long ) total );
+	return 0;
+}
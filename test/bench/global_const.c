@@ -0,0 +1,53 @@
+/*
+ * Heavy loads of global constants.
+ * The loads are RIP-relative and always return the same value
+ * from the same address, so they are global-stable.
+ *   global_const [iterations]
+ */
+# include <stdint.h>
+# include <stdio.h>
+# include <stdlib.h>
+
+static const uint64_t c0 = 0x9e3779b97f4a7c15ULL;
+static const uint32_t c1 = 0x85ebca6b;
+static const uint16_t c2 = 0xc2b2;
+static const uint8_t c3 = 0x27;
+static const double scale = 1.000001;
+
+volatile uint64_t sink;
+
+/* Plain or volatile reads get their address hoisted into a register
+ * out of the loop, which makes them REG loads; an asm memory operand
+ * on the symbol keeps every constant a [rip+sym] load */
+# define LOAD_RIP( insn, var, out, reg ) \
+	__asm__ volatile ( insn " %1, %0" : "=" reg ( out ) : "m" ( var ) )
+
+int main ( int argc, char *argv[] )
+{
+	long iterations = argc > 1 ? atol ( argv[1] ) : 10000000;
+	long i;
+	uint64_t h = 0, v0;
+	uint32_t v1;
+	uint16_t v2;
+	uint8_t v3;
+	double x = 1.0, s;
+
+	for ( i = 0; i < iterations; i++ )
+	{
+		LOAD_RIP ( "movq", c0, v0, "r" );
+		LOAD_RIP ( "movl", c1, v1, "r" );
+		LOAD_RIP ( "movw", c2, v2, "r" );
+		LOAD_RIP ( "movb", c3, v3, "q" );
+		LOAD_RIP ( "movsd", scale, s, "x" );
+		h ^= v0;
+		h += v1;
+		h ^= v2;
+		h += v3;
+		x *= s;
+		h = ( h << 7 ) | ( h >> 57 );
+	}
+
+	sink = h;
+	printf ( "%llx %f\n", ( unsigned long long ) h, x );
+	return 0;
+}
@@ -0,0 +1,52 @@
+/*
+ * Pointer chasing over a large working set.
+ * Every load depends on the previous one and misses the caches,
+ * and no load IP is stable.
+ *   pointer_chase [steps] [working set MB]
+ */
+# include <stdint.h>
+# include <stdio.h>
+# include <stdlib.h>
+
+typedef struct node
+{
+	struct node *next;
+	uint64_t pad[7];	/* one node per cache line */
+} node_t;
+
+int main ( int argc, char *argv[] )
+{
+	long steps = argc > 1 ? atol ( argv[1] ) : 10000000;
+	long mb = argc > 2 ? atol ( argv[2] ) : 256;
+	long n = mb * 1024 * 1024 / sizeof ( node_t );
+	long i;
+	long *order;
+	node_t *nodes;
+	node_t *p;
+
+	nodes = malloc ( n * sizeof ( node_t ) );
+	order = malloc ( n * sizeof ( long ) );
+
+	/* one random cycle through every node */
+	for ( i = 0; i < n; i++ )
+		order[i] = i;
+	srand ( 1 );
+	for ( i = n - 1; i > 0; i-- )
+	{
+		long j = ( ( long ) rand ( ) * RAND_MAX + rand ( ) ) % ( i + 1 );
+		long t = order[i];
+		order[i] = order[j];
+		order[j] = t;
+	}
+	for ( i = 0; i < n; i++ )
+		nodes[order[i]].next = &nodes[order[( i + 1 ) % n]];
+
+	p = &nodes[order[0]];
+	for ( i = 0; i < steps; i++ )
+		p = p->next;
+
+	printf ( "%ld\n", ( long ) ( p - nodes ) );
+	free ( order );
+	free ( nodes );
+	return 0;
+}
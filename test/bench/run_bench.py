@@ -0,0 +1,191 @@
+#!/usr/bin/env python3
+
+# Runs every benchmark kernel natively and under inspector, and
+# writes the slowdown, analyzed loads per second and peak RSS of
+# each to a JSON file. Given a baseline file from an earlier run,
+# exits with 1 if any kernel got slower by more than --threshold.
+#
+#   make all
+#   ./run_bench.py -o bench.json [--baseline old.json]
+
+import argparse
+import json
+import os
+import platform
+import subprocess
+import sys
+import time
+
+BENCH_DIR = os.path.dirname(os.path.abspath(__file__))
+INSPECTOR = os.path.join(BENCH_DIR, "..", "..", "inspector")
+
+# kernel binary -> arguments, sized to finish in minutes under SDE
+KERNELS = {
+    "pointer_chase": ["2000000", "64"],
+    "global_const": ["2000000"],
+    "shared_readers": ["1000000", "4"],
+    "vector_loads.avx2": ["50"],
+    "vector_loads.avx512": ["50"],
+    "gather.avx2": ["200"],
+    "gather.avx512": ["200"],
+}
+
+
+def add_arguments(parser):
+    parser.add_argument(
+        "-o",
+        "--output",
+        type=str,
+        default="bench.json",
+        help="JSON file the results are written to",
+    )
+    parser.add_argument(
+        "--kernels",
+        type=str,
+        default=",".join(KERNELS),
+        help="Comma-separated kernels to run",
+    )
+    parser.add_argument(
+        "--apx",
+        type=bool,
+        default=False,
+        help="Run the APX builds (make apx); they only run under inspector",
+    )
+    parser.add_argument(
+        "--inspector-args",
+        type=str,
+        default="",
+        help="Extra inspector arguments, e.g. \"--overhead 1\"",
+    )
+    parser.add_argument(
+        "--baseline",
+        type=str,
+        default=None,
+        help="JSON file of an earlier run to check for regressions",
+    )
+    parser.add_argument(
+        "--threshold",
+        type=float,
+        default=1.10,
+        help="Slowdown ratio over the baseline that counts as a regression",
+    )
+
+
+def run_measured(command, cwd):
+    """Runs a command; returns its wall seconds, peak RSS in KB of it
+    and its children, and its exit code"""
+    start = time.monotonic()
+    process = subprocess.Popen(command, cwd=cwd, stdout=subprocess.DEVNULL)
+    _, status, rusage = os.wait4(process.pid, 0)
+    seconds = time.monotonic() - start
+    return seconds, rusage.ru_maxrss, os.waitstatus_to_exitcode(status)
+
+
+def read_stats(filename):
+    stats = {}
+    with open(filename, 'r') as file:
+        for line in file:
+            fields = line.split()
+            if len(fields) == 2:
+                stats[fields[0]] = float(fields[1]) if '.' in fields[1] else int(fields[1])
+    return stats
+
+
+def run_kernel(kernel, binary, kernel_args, args, workdir):
+    """Returns the result record of one kernel"""
+    result = {"binary": binary, "args": kernel_args}
+
+    if not args.apx:
+        seconds, rss, code = run_measured([os.path.join(BENCH_DIR, binary)] + kernel_args, workdir)
+        # e.g. AVX-512 kernels on a machine without it
+        if code == 0:
+            result["native_seconds"] = seconds
+            result["native_peak_rss_kb"] = rss
+
+    prefix = os.path.join(workdir, kernel)
+    command = ([INSPECTOR, "-o", prefix] + args.inspector_args.split()
+               + ["--", os.path.join(BENCH_DIR, binary)] + kernel_args)
+    seconds, rss, code = run_measured(command, workdir)
+    if code != 0:
+        result["error"] = "inspector exited with {}".format(code)
+        return result
+
+    stats = read_stats(prefix + ".stats.txt")
+    loads = stats.get("load.total", 0)
+    result["inspector_seconds"] = seconds
+    result["inspector_peak_rss_kb"] = rss
+    result["tool_table_peak_bytes"] = stats.get("mem.tables.peak_bytes", 0)
+    result["loads"] = loads
+    result["load_ips"] = stats.get("load_ips.total", 0)
+    result["global_stable_load_ips"] = stats.get("global_stable_load_ips.total", 0)
+    result["loads_per_second"] = loads / seconds if seconds else 0
+    if "native_seconds" in result and result["native_seconds"]:
+        result["slowdown"] = seconds / result["native_seconds"]
+    return result
+
+
+def check_regressions(results, baseline, threshold):
+    """Returns the kernels whose inspector time grew past the threshold"""
+    regressions = []
+    for kernel, result in results.items():
+        old = baseline.get("kernels", {}).get(kernel)
+        if not old or "inspector_seconds" not in old or "inspector_seconds" not in result:
+            continue
+        # compare slowdowns when both have them, so machine noise cancels out
+        key = "slowdown" if "slowdown" in old and "slowdown" in result else "inspector_seconds"
+        ratio = result[key] / old[key] if old[key] else 0
+        if ratio > threshold:
+            regressions.append((kernel, key, old[key], result[key], ratio))
+    return regressions
+
+
+#########################
+# MAIN
+#########################
+
+parser = argparse.ArgumentParser()
+add_arguments(parser)
+args = parser.parse_args()
+
+for var in ("SDE_BUILD_KIT", "INSPECTOR_HOME"):
+    if var not in os.environ:
+        print("env[{}] is not set. Have you sourced setvars.sh?".format(var))
+        exit(1)
+
+workdir = os.path.abspath(os.path.splitext(args.output)[0] + ".runs")
+os.makedirs(workdir, exist_ok=True)
+
+results = {}
+for kernel in args.kernels.split(","):
+    if kernel not in KERNELS:
+        print("unknown kernel {}".format(kernel))
+        exit(1)
+    binary = kernel + ".apx" if args.apx else kernel
+    if not os.path.exists(os.path.join(BENCH_DIR, binary)):
+        print("{} is not built; run make {}".format(binary, "apx" if args.apx else "all"))
+        exit(1)
+
+    print("Running {}".format(binary))
+    results[kernel] = run_kernel(kernel, binary, KERNELS[kernel], args, workdir)
+    print("  " + ", ".join("{} {}".format(key, value) for key, value in results[kernel].items()
+                           if key not in ("binary", "args")))
+
+with open(args.output, 'w') as file:
+    json.dump({
+        "machine": platform.node(),
+        "cpus": os.cpu_count(),
+        "date": time.strftime("%Y-%m-%dT%H:%M:%S"),
+        "apx": args.apx,
+        "inspector_args": args.inspector_args,
+        "kernels": results,
+    }, file, indent=2)
+print("Wrote {}".format(args.output))
+
+if args.baseline:
+    with open(args.baseline, 'r') as file:
+        baseline = json.load(file)
+    regressions = check_regressions(results, baseline, args.threshold)
+    for kernel, key, old, new, ratio in regressions:
+        print("REGRESSION {}: {} {:.3f} -> {:.3f} ({:.2f}x)".format(kernel, key, old, new, ratio))
+    if regressions:
+        exit(1)
@@ -0,0 +1,70 @@
+/*
+ * Threads reading shared, read-mostly data.
+ * Reader threads sum a shared table that a writer thread updates
+ * rarely, so the table loads are stable in some threads and turn
+ * unstable in others.
+ *   shared_readers [iterations] [threads]
+ */
+# include <pthread.h>
+# include <stdint.h>
+# include <stdio.h>
+# include <stdlib.h>
+
+# define TABLE_SIZE 4096
+
+static volatile uint64_t table[TABLE_SIZE];
+static long iterations;
+
+static void *reader ( void *arg )
+{
+	uint64_t sum = 0;
+	long i;
+
+	for ( i = 0; i < iterations; i++ )
+		sum += table[i % TABLE_SIZE];
+
+	*( uint64_t * ) arg = sum;
+	return NULL;
+}
+
+static void *writer ( void *arg )
+{
+	long i;
+
+	( void ) arg;
+	for ( i = 0; i < iterations / 1000; i++ )
+		table[( i * 7 ) % TABLE_SIZE]++;
+	return NULL;
+}
+
+int main ( int argc, char *argv[] )
+{
+	int nthreads = argc > 2 ? atoi ( argv[2] ) : 4;
+	pthread_t *threads;
+	pthread_t writer_thread;
+	uint64_t *sums;
+	uint64_t total = 0;
+	int t;
+
+	iterations = argc > 1 ? atol ( argv[1] ) : 10000000;
+	threads = malloc ( nthreads * sizeof ( pthread_t ) );
+	sums = calloc ( nthreads, sizeof ( uint64_t ) );
+
+	for ( t = 0; t < TABLE_SIZE; t++ )
+		table[t] = t;
+
+	pthread_create ( &writer_thread, NULL, writer, NULL );
+	for ( t = 0; t < nthreads; t++ )
+		pthread_create ( &threads[t], NULL, reader, &sums[t] );
+	for ( t = 0; t < nthreads; t++ )
+	{
+		pthread_join ( threads[t], NULL );
+		total += sums[t];
+	}
+	pthread_join ( writer_thread, NULL );
+
+	printf ( "%llu\n", ( unsigned long long ) total );
+	free ( sums );
+	free ( threads );
+	return 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * 32B (AVX2) or 64B (AVX-512) vector loads.
+ * Streams over an array that is rewritten between passes, and
+ * reloads a constant vector that stays stable.
+ * Built as vector_loads.avx2 and vector_loads.avx512.
+ *   vector_loads [passes]
+ */
+# include <immintrin.h>
+# include <stdint.h>
+# include <stdio.h>
+# include <stdlib.h>
+
+# define N ( 1 << 16 )
+
+static int32_t data[N] __attribute__ ( ( aligned ( 64 ) ) );
+
+/* A volatile vector object, so every read is one full-width load;
+ * a volatile cast of a plain array gets folded into a broadcast */
+#ifdef __AVX512F__
+static volatile __m512i ones;
+#else
+static volatile __m256i ones;
+#endif
+
+int main ( int argc, char *argv[] )
+{
+	long passes = argc > 1 ? atol ( argv[1] ) : 200;
+	long p;
+	int i;
+	int32_t out[16];
+	int64_t total = 0;
+
+	for ( i = 0; i < N; i++ )
+		data[i] = i;
+#ifdef __AVX512F__
+	ones = _mm512_set1_epi32 ( 1 );
+#else
+	ones = _mm256_set1_epi32 ( 1 );
+#endif
+
+	for ( p = 0; p < passes; p++ )
+	{
+#ifdef __AVX512F__
+		__m512i acc = _mm512_setzero_si512 ( );
+		for ( i = 0; i < N; i += 16 )
+		{
+			__m512i v = _mm512_load_si512 ( ( const void * ) &data[i] );
+			__m512i one = ones;
+			acc = _mm512_add_epi32 ( acc, _mm512_add_epi32 ( v, one ) );
+		}
+		_mm512_storeu_si512 ( ( void * ) out, acc );
+		for ( i = 0; i < 16; i++ )
+			total += out[i];
+#else
+		__m256i acc = _mm256_setzero_si256 ( );
+		for ( i = 0; i < N; i += 8 )
+		{
+			__m256i v = _mm256_load_si256 ( ( const __m256i * ) &data[i] );
+			__m256i one = ones;
+			acc = _mm256_add_epi32 ( acc, _mm256_add_epi32 ( v, one ) );
+		}
+		_mm256_storeu_si256 ( ( __m256i * ) out, acc );
+		for ( i = 0; i < 8; i++ )
+			total += out[i];
+#endif
+		data[p % N]++;
+	}
+
+	printf ( "%lld\n", ( long long ) total );
+	return 0;
+}
@@ -0,0 +1,90 @@
+/*
+ * Golden program for scalar loads.
+ * The ROI, between SSC marks 1 and 2, runs ITERATIONS times a
+ * loop of hand-written loads whose type, size and stability are
+ * known by construction (see golden_scalar.json). Stable loads are
+ * labelled golden_stable_*; the harness looks them up with nm.
+ */
+# include <stdint.h>
+# include <stdio.h>
+
+# define ITERATIONS 1000
+
+const uint8_t rip_byte = 0x11;
+const uint16_t rip_word = 0x2222;
+const uint32_t rip_dword = 0x33333333;
+const uint64_t rip_qword = 0x4444444444444444ULL;
+
+uint32_t reg_dword = 0x55555555;
+uint64_t reg_array[ITERATIONS];
+uint16_t reg_changing_word;
+uint64_t string_a[1] = { 1 }, string_b[1] = { 2 };
+
+void golden_roi ( void );
+
+__asm__ (
+	".intel_syntax noprefix\n"
+	".text\n"
+	".globl golden_roi\n"
+	"golden_roi:\n"
+	"	push rbx\n"
+	"	push rbp\n"
+	"	push rsi\n"
+	"	push rdi\n"
+	"	sub rsp, 16\n"
+	"	mov rbp, rsp\n"
+	"	mov qword ptr [rsp + 8], 42\n"
+	"	lea r10, [rip + reg_dword]\n"
+	"	lea rdx, [rip + reg_array]\n"
+	"	lea r8, [rip + reg_changing_word]\n"
+	"	mov ecx, 1000\n"
+	/* SSC mark 1 starts the ROI; the jump ends the trace, so the
+	   loop is instrumented with the ROI on */
+	"	mov ebx, 1\n"
+	"	.byte 0x64, 0x67, 0x90\n"
+	"	jmp 1f\n"
+	"1:\n"
+	"golden_stable_rip_1b:\n"
+	"	movzx eax, byte ptr [rip + rip_byte]\n"
+	"golden_stable_rip_2b:\n"
+	"	movzx eax, word ptr [rip + rip_word]\n"
+	"golden_stable_rip_4b:\n"
+	"	mov eax, dword ptr [rip + rip_dword]\n"
+	"golden_stable_rip_8b:\n"
+	"	mov rax, qword ptr [rip + rip_qword]\n"
+	"golden_stable_stack_8b:\n"
+	"	mov rax, qword ptr [rsp + 8]\n"
+	/* same address, value rewritten every iteration */
+	"	mov eax, dword ptr [rbp + 4]\n"
+	"	mov dword ptr [rbp + 4], ecx\n"
+	"golden_stable_reg_4b:\n"
+	"	mov eax, dword ptr [r10]\n"
+	/* new address every iteration */
+	"	mov rax, qword ptr [rdx + rcx * 8 - 8]\n"
+	"	movzx eax, word ptr [r8]\n"
+	"	mov word ptr [r8], cx\n"
+	/* two reads of one instruction share its slot */
+	"	lea rsi, [rip + string_a]\n"
+	"	lea rdi, [rip + string_b]\n"
+	"	cmpsq\n"
+	"	dec ecx\n"
+	"	jnz 1b\n"
+	"	mov ebx, 2\n"
+	"	.byte 0x64, 0x67, 0x90\n"
+	"	jmp 2f\n"
+	"2:\n"
+	"	add rsp, 16\n"
+	"	pop rdi\n"
+	"	pop rsi\n"
+	"	pop rbp\n"
+	"	pop rbx\n"
+	"	ret\n"
+	".att_syntax prefix\n"
+);
+
+int main ( )
+{
+	golden_roi ( );
+	printf ( "done\n" );
+	return 0;
+}
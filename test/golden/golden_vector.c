@@ -0,0 +1,75 @@
+/*
+ * Golden program for vector loads and gathers.
+ * Like golden_scalar, the ROI between SSC marks 1 and 2 runs
+ * ITERATIONS times a loop of hand-written loads (see
+ * golden_vector.json). Gathers go through the tool's address
+ * generation path, one GATHER load per element, each element
+ * with its own stability. Needs AVX-512, so it only runs under
+ * SDE.
+ */
+# include <stdint.h>
+# include <stdio.h>
+
+# define ITERATIONS 1000
+
+const uint8_t vec_const[32] __attribute__ ( ( aligned ( 32 ) ) ) = { 1, 2, 3, 4 };
+const int32_t gather_indices[8] __attribute__ ( ( aligned ( 32 ) ) ) = { 0, 1, 2, 3, 4, 5, 6, 7 };
+
+uint8_t vec_data[64] __attribute__ ( ( aligned ( 64 ) ) ) = { 5, 6, 7, 8 };
+uint8_t vec_stream[ITERATIONS * 16];
+int32_t gather_data[8] = { 10, 11, 12, 13, 14, 15, 16, 17 };
+
+void golden_roi ( void );
+
+__asm__ (
+	".intel_syntax noprefix\n"
+	".text\n"
+	".globl golden_roi\n"
+	"golden_roi:\n"
+	"	push rbx\n"
+	"	lea r10, [rip + vec_data]\n"
+	"	lea rdx, [rip + vec_stream]\n"
+	"	lea r11, [rip + gather_data]\n"
+	"	vpxor ymm1, ymm1, ymm1\n"
+	"	vmovdqu ymm3, ymmword ptr [rip + gather_indices]\n"
+	"	mov ecx, 1000\n"
+	"	mov ebx, 1\n"
+	"	.byte 0x64, 0x67, 0x90\n"
+	"	jmp 1f\n"
+	"1:\n"
+	"golden_stable_reg_16b:\n"
+	"	movdqu xmm0, xmmword ptr [r10]\n"
+	/* new address every iteration */
+	"	mov rax, rcx\n"
+	"	shl rax, 4\n"
+	"	movdqu xmm0, xmmword ptr [rdx + rax - 16]\n"
+	"golden_stable_rip_32b:\n"
+	"	vmovdqu ymm0, ymmword ptr [rip + vec_const]\n"
+	"golden_stable_reg_64b:\n"
+	"	vmovdqu64 zmm0, zmmword ptr [r10]\n"
+	/* eight loads of the same element */
+	"	vpcmpeqd ymm2, ymm2, ymm2\n"
+	"golden_stable_gather_4b:\n"
+	"	vpgatherdd ymm0, dword ptr [r11 + ymm1 * 4], ymm2\n"
+	/* eight different elements, each the same every iteration */
+	"	vpcmpeqd ymm2, ymm2, ymm2\n"
+	"golden_stable_gather_elements_4b:\n"
+	"	vpgatherdd ymm0, dword ptr [r11 + ymm3 * 4], ymm2\n"
+	"	dec ecx\n"
+	"	jnz 1b\n"
+	"	mov ebx, 2\n"
+	"	.byte 0x64, 0x67, 0x90\n"
+	"	jmp 2f\n"
+	"2:\n"
+	"	vzeroupper\n"
+	"	pop rbx\n"
+	"	ret\n"
+	".att_syntax prefix\n"
+);
+
+int main ( )
+{
+	golden_roi ( );
+	printf ( "done\n" );
+	return 0;
+}
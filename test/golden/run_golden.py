@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+
+# Runs every golden program under inspector, restricted to the ROI
+# between its SSC marks 1 and 2, and diffs the stats against the
+# expectations in <program>.json. Every load.*, global_stable_*,
+# load_ips.total and icount.agen stat is checked; stats missing
+# from the JSON file are expected to be zero. The global-stable
+# load IPs must be exactly the golden_stable_* labels of the
+# program. Exits with 1 on any mismatch.
+#
+#   make all
+#   ./run_golden.py [--inspector-args "--locality 1"]
+
+import argparse
+import glob
+import json
+import os
+import subprocess
+
+GOLDEN_DIR = os.path.dirname(os.path.abspath(__file__))
+INSPECTOR = os.path.join(GOLDEN_DIR, "..", "..", "inspector")
+
+CHECKED_PREFIXES = ("load.", "global_stable_load_ips.", "global_stable_loads.")
+CHECKED_KEYS = ("load_ips.total", "icount.agen")
+
+
+def add_arguments(parser):
+    parser.add_argument(
+        "--programs",
+        type=str,
+        default=None,
+        help="Comma-separated programs to check (default: every <program>.json)",
+    )
+    parser.add_argument(
+        "--inspector-args",
+        type=str,
+        default="",
+        help="Extra inspector arguments, to check another mode of the tool",
+    )
+    parser.add_argument(
+        "--workdir",
+        type=str,
+        default="golden.runs",
+        help="Directory for the outputs of the runs",
+    )
+
+
+def read_stats(filename):
+    stats = {}
+    with open(filename, 'r') as file:
+        for line in file:
+            fields = line.split()
+            if len(fields) == 2:
+                stats[fields[0]] = float(fields[1]) if '.' in fields[1] else int(fields[1])
+    return stats
+
+
+def stable_labels(binary):
+    """Address -> name of the golden_stable_* labels of a binary"""
+    labels = {}
+    output = subprocess.check_output(["nm", binary], universal_newlines=True)
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 3 and fields[2].startswith("golden_stable_"):
+            labels[int(fields[0], 16)] = fields[2]
+    return labels
+
+
+def dumped_stable_ips(filename):
+    with open(filename, 'r') as file:
+        file.readline()
+        return set(int(line.split(',')[0], 16) for line in file if line.strip())
+
+
+def check_program(program, args, workdir):
+    """Returns the mismatches of one program"""
+    with open(os.path.join(GOLDEN_DIR, program + ".json"), 'r') as file:
+        golden = json.load(file)
+    binary = os.path.join(GOLDEN_DIR, golden["binary"])
+    if not os.path.exists(binary):
+        return ["{} is not built; run make all".format(golden["binary"])]
+
+    output = os.path.join(workdir, program)
+    command = ([INSPECTOR, "-o", output, "--ssc-roi", "1,2", "--dump-loads", "1"]
+               + args.inspector_args.split() + ["--", binary])
+    code = subprocess.call(command, stdout=subprocess.DEVNULL)
+    if code:
+        return ["inspector exited with {}".format(code)]
+
+    stats = read_stats(output + ".stats.txt")
+    expected = golden["stats"]
+    tolerance = golden.get("tolerance", {})
+    mismatches = []
+
+    keys = set(expected)
+    keys.update(key for key in stats if key.startswith(CHECKED_PREFIXES) or key in CHECKED_KEYS)
+    for key in sorted(keys):
+        want = expected.get(key, 0)
+        got = stats.get(key)
+        if got is None:
+            mismatches.append("{}: missing, expected {}".format(key, want))
+        elif abs(got - want) > tolerance.get(key, 0):
+            mismatches.append("{}: {}, expected {}".format(key, got, want))
+
+    labels = stable_labels(binary)
+    dumped = dumped_stable_ips(output + ".ips.txt")
+    for ip in sorted(set(labels) - dumped):
+        mismatches.append("{} (0x{:x}) is not global-stable".format(labels[ip], ip))
+    for ip in sorted(dumped - set(labels)):
+        mismatches.append("0x{:x} is global-stable, but not a golden_stable_* label".format(ip))
+
+    return mismatches
+
+
+#########################
+# MAIN
+#########################
+
+parser = argparse.ArgumentParser()
+add_arguments(parser)
+args = parser.parse_args()
+
+for var in ("SDE_BUILD_KIT", "INSPECTOR_HOME"):
+    if var not in os.environ:
+        print("env[{}] is not set. Have you sourced setvars.sh?".format(var))
+        exit(1)
+
+if args.programs:
+    programs = args.programs.split(",")
+else:
+    programs = sorted(os.path.splitext(os.path.basename(path))[0]
+                      for path in glob.glob(os.path.join(GOLDEN_DIR, "*.json")))
+
+workdir = os.path.abspath(args.workdir)
+os.makedirs(workdir, exist_ok=True)
+
+failed = 0
+for program in programs:
+    mismatches = check_program(program, args, workdir)
+    print("{} {}".format("FAIL" if mismatches else "PASS", program))
+    for mismatch in mismatches:
+        print("  " + mismatch)
+    failed += bool(mismatches)
+
+print("{} of {} golden programs passed".format(len(programs) - failed, len(programs)))
+if failed:
+    exit(1)
@@ -0,0 +1,169 @@
+/**********************************************************
+ * Reads the live stats region of a running Load Inspector
+ * (-live_file). Prints the latest counters in the format of
+ * the stats file, or, given a period in ms, one line of them
+ * per period until the run is done or its process is gone.
+ *   live_stats <live file> [period_ms]
+ **********************************************************/
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/live_format.h"
+
+static const char* load_type2str[] = { "RIP", "STACK", "REG", "GATHER" };
+static const char* load_size2str[] = { "1B", "2B", "4B", "8B", "16B", "32B", "64B", "UNCATEGORIZED" };
+static const char* mem_table2str[] = { "ip_table", "slots", "vector_values", "locality" };
+
+// NULL if the file cannot be mapped, or is shorter than a region (e.g.
+// a stale file, or one the tool has not sized yet), as reading a page
+// past its end would raise SIGBUS
+static const live_region_t* map_region(const char* filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return NULL;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(live_region_t))
+    {
+        close(fd);
+        return NULL;
+    }
+    void* region = mmap(NULL, sizeof(live_region_t), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    return region == MAP_FAILED ? NULL : (const live_region_t*)region;
+}
+
+// Copies the latest update out; FALSE if there is none yet
+static bool read_counters(const live_region_t* region, live_counters_t& c)
+{
+    while (true)
+    {
+        uint64_t seq = __atomic_load_n(&region->seq, __ATOMIC_ACQUIRE);
+        if (!seq)
+            return false;
+        memcpy(&c, (const void*)&region->copies[seq & 1], sizeof(c));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        // the writer may be rewriting the copy as soon as it publishes
+        // the next update
+        if (__atomic_load_n(&region->seq, __ATOMIC_RELAXED) == seq)
+            return true;
+    }
+}
+
+static uint64_t total_loads(const live_counters_t& c)
+{
+    uint64_t total = 0;
+    for (uint32_t type = 0; type < LIVE_NUM_LOAD_TYPES; type++)
+        for (uint32_t size = 0; size < LIVE_NUM_LOAD_SIZES; size++)
+            total += c.load_count[type][size];
+    return total;
+}
+
+static void print_counters(const live_region_t* region, const live_counters_t& c)
+{
+    std::cout << "live.pid " << region->pid << std::endl;
+    std::cout << "live.seq " << c.seq << std::endl;
+    std::cout << "live.time_ns " << c.time_ns << std::endl;
+    std::cout << "live.done " << c.done << std::endl;
+    std::cout << "live.threads " << c.num_threads << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "icount.total " << c.icount << std::endl;
+    std::cout << "icount.inside_roi " << c.icount_inside_roi << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "load.total " << total_loads(c) << std::endl;
+    for (uint32_t type = 0; type < LIVE_NUM_LOAD_TYPES; type++)
+        for (uint32_t size = 0; size < LIVE_NUM_LOAD_SIZES; size++)
+            std::cout << "load." << load_type2str[type] << "." << load_size2str[size] << " "
+                      << c.load_count[type][size] << std::endl;
+    std::cout << std::endl;
+
+    std::cout << "live.load_ips " << c.load_ips << std::endl;
+    std::cout << "live.new_stable_ips " << c.new_stable_ips << std::endl;
+    std::cout << "prune.unstable_ips " << c.unstable_ips << std::endl;
+    std::cout << "mem.untracked_load_ips " << c.untracked_load_ips << std::endl;
+    for (uint32_t table = 0; table < LIVE_NUM_MEM_TABLES; table++)
+        std::cout << "mem." << mem_table2str[table] << ".bytes " << c.mem_table_bytes[table] << std::endl;
+    std::cout << "mem.tables.peak_bytes " << c.mem_tables_peak_bytes << std::endl;
+}
+
+static void print_line(const live_counters_t& c)
+{
+    uint64_t mem = 0;
+    for (uint32_t table = 0; table < LIVE_NUM_MEM_TABLES; table++)
+        mem += c.mem_table_bytes[table];
+    std::cout << c.seq
+              << " " << c.time_ns
+              << " " << c.icount
+              << " " << c.icount_inside_roi
+              << " " << total_loads(c)
+              << " " << c.load_ips
+              << " " << c.unstable_ips
+              << " " << mem << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <live file> [period_ms]" << std::endl;
+        return 1;
+    }
+
+    const live_region_t* region = map_region(argv[1]);
+    if (!region)
+    {
+        std::cerr << "cannot map " << argv[1] << ", or it is too short to be a live stats file" << std::endl;
+        return 1;
+    }
+    if (memcmp(region->magic, LIVE_STATS_MAGIC, sizeof(region->magic)) || region->version != LIVE_STATS_VERSION)
+    {
+        std::cerr << argv[1] << " is not a live stats file of version " << LIVE_STATS_VERSION << std::endl;
+        return 1;
+    }
+
+    live_counters_t c;
+    if (argc == 2)
+    {
+        if (!read_counters(region, c))
+        {
+            std::cerr << "no update yet" << std::endl;
+            return 1;
+        }
+        print_counters(region, c);
+        return 0;
+    }
+
+    uint32_t period_ms = strtoul(argv[2], NULL, 10);
+    struct timespec period = { period_ms / 1000, (long)(period_ms % 1000) * 1000000 };
+    uint64_t last_seq = 0;
+    std::cout << "# seq time_ns icount icount.inside_roi load.total load_ips unstable_ips mem.tables.bytes" << std::endl;
+    while (true)
+    {
+        if (read_counters(region, c) && c.seq != last_seq)
+        {
+            print_line(c);
+            last_seq = c.seq;
+            if (c.done)
+                return 0;
+        }
+        // a killed target never writes its final update
+        else if (kill(region->pid, 0) < 0 && errno == ESRCH)
+        {
+            std::cerr << "process " << region->pid << " exited without a final update" << std::endl;
+            return 1;
+        }
+        nanosleep(&period, NULL);
+    }
+}
@@ -0,0 +1,163 @@
+/**********************************************************
+ * Load Inspector binary profile reader
+ * mmaps a profile written with -binf and exposes its
+ * records and image table in place, without parsing.
+ **********************************************************/
+
+#ifndef LOAD_PROFILE_H
+#define LOAD_PROFILE_H
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <string>
+
+#include "../src/profile_format.h"
+
+static inline const char* load_profile_state2str(uint8_t state)
+{
+    static const char* names[] = { "STABLE", "UNSTABLE", "SEEN_ONCE" };
+    return state < NUM_PROFILE_STATES ? names[state] : "INVALID";
+}
+
+// Load types and size buckets a record may hold (load_type_t and
+// load_size2str of the tool)
+const uint32_t PROFILE_NUM_LOAD_TYPES = 4;
+const uint32_t PROFILE_NUM_SIZES = 8;
+
+class load_profile
+{
+  public:
+    load_profile() : _base(NULL), _length(0) {}
+    ~load_profile() { close(); }
+
+    load_profile(const load_profile&) = delete;
+    load_profile& operator=(const load_profile&) = delete;
+
+    // Maps a profile file; returns false (see error()) if it is not a valid
+    // profile, or if any record has a field out of range
+    bool open(const std::string& filename)
+    {
+        close();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return fail("cannot open " + filename);
+
+        struct stat st;
+        if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(load_profile_header_t))
+        {
+            ::close(fd);
+            return fail(filename + " is too short to be a profile");
+        }
+
+        void* base = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (base == MAP_FAILED)
+            return fail("cannot mmap " + filename);
+
+        _base = (const char*)base;
+        _length = st.st_size;
+
+        const load_profile_header_t* h = header();
+        if (memcmp(h->magic, LOAD_PROFILE_MAGIC, sizeof(h->magic)))
+            return fail(filename + " is not a load profile");
+        if (h->version != LOAD_PROFILE_VERSION || h->record_size != sizeof(load_profile_record_t))
+            return fail(filename + " has an unsupported profile version");
+        if (h->images_offset != sizeof(load_profile_header_t) + h->num_records * h->record_size ||
+            h->images_offset + h->num_images * sizeof(load_profile_image_t) > _length)
+            return fail(filename + " is truncated");
+        for (uint32_t i = 0; i < h->num_images; i++)
+        {
+            const load_profile_image_t& img = image(i);
+            if (img.first_record + img.num_records > h->num_records ||
+                (const char*)names() + img.name_offset + img.name_length > _base + _length)
+                return fail(filename + " has a corrupt image table");
+        }
+        // the readers index name tables by these fields
+        for (const load_profile_record_t* it = begin(); it != end(); ++it)
+        {
+            if (it->load_type >= PROFILE_NUM_LOAD_TYPES || it->sizeb >= PROFILE_NUM_SIZES ||
+                it->state >= NUM_PROFILE_STATES || it->image >= h->num_images)
+                return fail(filename + " has a corrupt record at index " + std::to_string(it - begin()));
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+        if (_base)
+            munmap((void*)_base, _length);
+        _base = NULL;
+        _length = 0;
+    }
+
+    const std::string& error() const { return _error; }
+
+    const load_profile_header_t* header() const { return (const load_profile_header_t*)_base; }
+    uint64_t size() const { return header()->num_records; }
+
+    const load_profile_record_t* begin() const
+    {
+        return (const load_profile_record_t*)(_base + sizeof(load_profile_header_t));
+    }
+    const load_profile_record_t* end() const { return begin() + size(); }
+    const load_profile_record_t& operator[](uint64_t i) const { return begin()[i]; }
+
+    uint32_t num_images() const { return header()->num_images; }
+    const load_profile_image_t& image(uint32_t i) const
+    {
+        return ((const load_profile_image_t*)(_base + header()->images_offset))[i];
+    }
+    std::string image_name(uint32_t i) const
+    {
+        return std::string(names() + image(i).name_offset, image(i).name_length);
+    }
+    const load_profile_record_t* image_begin(uint32_t i) const { return begin() + image(i).first_record; }
+    const load_profile_record_t* image_end(uint32_t i) const { return image_begin(i) + image(i).num_records; }
+
+    // IP relative to the image the record belongs to
+    uint64_t offset(const load_profile_record_t& rec) const { return rec.ip - image(rec.image).low; }
+
+    // Records are sorted by IP inside each image, so lookups are a
+    // binary search in the image containing ip, or in the anonymous one.
+    // The element records of a multi-reference load follow the first.
+    const load_profile_record_t* find(uint64_t ip) const
+    {
+        for (uint32_t i = 0; i < num_images(); i++)
+        {
+            if (ip < image(i).low || ip >= image(i).high)
+                continue;
+
+            const load_profile_record_t* it = std::lower_bound(image_begin(i), image_end(i), ip,
+                    [](const load_profile_record_t& rec, uint64_t key) { return rec.ip < key; });
+            if (it != image_end(i) && it->ip == ip)
+                return it;
+        }
+        return NULL;
+    }
+
+  private:
+    const char* names() const
+    {
+        return _base + header()->images_offset + header()->num_images * sizeof(load_profile_image_t);
+    }
+
+    bool fail(const std::string& error)
+    {
+        close();
+        _error = error;
+        return false;
+    }
+
+    const char* _base;
+    size_t _length;
+    std::string _error;
+};
+
+#endif
@@ -0,0 +1,112 @@
+###################################################
+# Load Inspector binary profile loader
+# Memory-maps a profile written with -binf as a
+# numpy record array; nothing is parsed or copied.
+###################################################
+
+import argparse
+import numpy as np
+
+MAGIC = b"LDINSPRF"
+VERSION = 3
+ANON_IMAGE = "[anonymous]"
+
+LOAD_TYPES = ["RIP", "STACK", "REG", "GATHER"]
+LOAD_SIZES = ["1B", "2B", "4B", "8B", "16B", "32B", "64B", "UNCATEGORIZED"]
+STATES = ["STABLE", "UNSTABLE", "SEEN_ONCE"]
+
+HEADER_DTYPE = np.dtype([
+    ("magic", "S8"),
+    ("version", "<u4"),
+    ("record_size", "<u4"),
+    ("num_records", "<u8"),
+    ("icount", "<u8"),
+    ("icount_inside_roi", "<u8"),
+    ("num_images", "<u4"),
+    ("reserved0", "<u4"),
+    ("images_offset", "<u8"),
+    ("reserved", "V8"),
+])
+
+RECORD_DTYPE = np.dtype([
+    ("ip", "<u8"),
+    ("addr", "<u8"),
+    ("val", "<u8"),
+    ("count", "<u8"),
+    ("load_type", "u1"),
+    ("sizeb", "u1"),
+    ("state", "u1"),
+    ("element", "u1"),
+    ("image", "<u4"),
+])
+
+IMAGE_DTYPE = np.dtype([
+    ("low", "<u8"),
+    ("high", "<u8"),
+    ("first_record", "<u8"),
+    ("num_records", "<u8"),
+    ("name_offset", "<u8"),
+    ("name_length", "<u8"),
+])
+
+
+def load_profile(file_path):
+    """Returns (header, records) of a profile; records are grouped by image
+    and sorted by ip inside each image"""
+    header = np.memmap(file_path, dtype=HEADER_DTYPE, mode="r", shape=(1,))[0]
+    if header["magic"] != MAGIC:
+        raise ValueError(file_path + " is not a load profile")
+    if header["version"] != VERSION or header["record_size"] != RECORD_DTYPE.itemsize:
+        raise ValueError(file_path + " has an unsupported profile version")
+
+    records = np.memmap(file_path, dtype=RECORD_DTYPE, mode="r",
+                        offset=HEADER_DTYPE.itemsize, shape=(int(header["num_records"]),))
+    return header, records
+
+
+def load_images(file_path, header):
+    """Returns the image table as a list of (name, image record) pairs"""
+    images = np.memmap(file_path, dtype=IMAGE_DTYPE, mode="r",
+                       offset=int(header["images_offset"]), shape=(int(header["num_images"]),))
+    names_offset = int(header["images_offset"]) + IMAGE_DTYPE.itemsize * len(images)
+    with open(file_path, "rb") as f:
+        f.seek(names_offset)
+        names = f.read()
+    return [(names[img["name_offset"]:img["name_offset"] + img["name_length"]].decode(), img)
+            for img in images]
+
+
+def find(records, images, ip):
+    """Returns the record of ip, or None"""
+    for _, img in images:
+        if not img["low"] <= ip < img["high"]:
+            continue
+        first = int(img["first_record"])
+        ips = records["ip"][first:first + int(img["num_records"])]
+        i = np.searchsorted(ips, ip)
+        if i < len(ips) and ips[i] == ip:
+            return records[first + i]
+    return None
+
+
+#########################
+# MAIN
+#########################
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("profile", type=str, help="Binary profile file name")
+    args = parser.parse_args()
+
+    header, records = load_profile(args.profile)
+    images = load_images(args.profile, header)
+    print("icount.total {}".format(header["icount"]))
+    print("icount.inside_roi {}".format(header["icount_inside_roi"]))
+    print("load_ips.total {}".format(len(records)))
+    for state, name in enumerate(STATES):
+        selected = records["state"] == state
+        print("load_ips.{} {}".format(name, np.count_nonzero(selected)))
+        print("loads.{} {}".format(name, records["count"][selected].sum()))
+    for name, img in images:
+        if img["num_records"]:
+            print("load_ips.image.{} {}".format(name, img["num_records"]))
@@ -0,0 +1,70 @@
+/**********************************************************
+ * Prints a Load Inspector binary profile as CSV, or looks
+ * up the given IPs in it.
+ *   load_profile_dump <profile> [ip ...]
+ **********************************************************/
+
+#include <cstdlib>
+#include <iostream>
+
+#include "load_profile.h"
+
+static const char* load_type2str[] = { "RIP", "STACK", "REG", "GATHER" };
+static const char* load_size2str[] = { "1B", "2B", "4B", "8B", "16B", "32B", "64B", "UNCATEGORIZED" };
+
+static void print_record(const load_profile& profile, const load_profile_record_t& rec)
+{
+    std::cout << "0x" << std::hex << rec.ip
+              << "," << profile.image_name(rec.image)
+              << ",0x" << profile.offset(rec)
+              << "," << std::dec << rec.count
+              << "," << load_type2str[rec.load_type]
+              << "," << (uint32_t)rec.element
+              << "," << load_size2str[rec.sizeb]
+              << "," << load_profile_state2str(rec.state)
+              << ",0x" << std::hex << rec.addr
+              << ",0x" << rec.val << std::dec << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " <profile> [ip ...]" << std::endl;
+        return 1;
+    }
+
+    load_profile profile;
+    if (!profile.open(argv[1]))
+    {
+        std::cerr << profile.error() << std::endl;
+        return 1;
+    }
+
+    std::cout << "ip,image,offset,count,load_type,element,size,state,addr,val" << std::endl;
+
+    if (argc == 2)
+    {
+        for (const load_profile_record_t* it = profile.begin(); it != profile.end(); ++it)
+            print_record(profile, *it);
+        return 0;
+    }
+
+    int missing = 0;
+    for (int i = 2; i < argc; i++)
+    {
+        uint64_t ip = strtoull(argv[i], NULL, 0);
+        const load_profile_record_t* rec = profile.find(ip);
+        if (rec)
+        {
+            for (; rec != profile.end() && rec->ip == ip; ++rec)
+                print_record(profile, *rec);
+        }
+        else
+        {
+            std::cerr << argv[i] << " not found" << std::endl;
+            missing++;
+        }
+    }
+    return missing ? 1 : 0;
+}
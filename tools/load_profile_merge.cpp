@@ -0,0 +1,319 @@
+/**********************************************************
+ * Merges Load Inspector binary profiles of several runs
+ * (e.g. different inputs) to find loads that are stable
+ * across all of them.
+ *   load_profile_merge [-j threads] [-o merged.csv] <profile> ...
+ *
+ * Load IPs are matched by (image name, image offset, element), so
+ * profiles taken under ASLR line up. Profiles stay mmap-ed;
+ * each image is merged by a streaming k-way merge over the
+ * per-image record ranges, and images are spread over the
+ * worker threads.
+ **********************************************************/
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "load_profile.h"
+#include "../src/csv.h"
+
+// Inputs that executed a load only once neither confirm nor refute
+// its stability, so they only count towards "executed by all",
+// unless no input executed it more than once
+typedef enum
+{
+    STABLE_ALL_INPUTS = 0,  // stable in every input, with the same value and address in all of them
+    STABLE_WHERE_SEEN,      // as above, but not executed by all
+    STABLE_PER_INPUT,       // stable wherever executed more than once, but inputs loaded different values or addresses
+    STABLE_SOME_INPUTS,     // stable in some inputs, unstable in others
+    UNSTABLE_ALL_INPUTS,    // never stable
+    NUM_MERGE_CLASSES
+} merge_class_t;
+
+static const char* merge_class2str[] = { "stable_all_inputs", "stable_where_seen", "stable_per_input", "stable_some_inputs",
+                                         "unstable" };
+
+typedef struct
+{
+    uint64_t union_ips = 0;
+    uint64_t intersection_ips = 0;  // executed by every input
+    uint64_t classes[NUM_MERGE_CLASSES] = {};
+    std::vector<uint64_t> seen_in;  // IPs executed by exactly k+1 inputs
+} merge_stats_t;
+
+// Record range of one image in one input
+typedef struct
+{
+    uint32_t input;
+    const load_profile_record_t* cur;
+    const load_profile_record_t* end;
+    uint64_t low;
+} merge_cursor_t;
+
+typedef struct
+{
+    std::string name;
+    std::vector<merge_cursor_t> ranges;
+} merge_job_t;
+
+static const char* load_type2str[] = { "RIP", "STACK", "REG", "GATHER" };
+static const char* load_size2str[] = { "1B", "2B", "4B", "8B", "16B", "32B", "64B", "UNCATEGORIZED" };
+
+static std::string part_filename(const std::string& output, size_t job)
+{
+    return output + ".part" + std::to_string(job);
+}
+
+//-------------------------------//
+// Merges one image across every input
+//-------------------------------//
+static void merge_image(const merge_job_t& job, uint32_t num_inputs, merge_stats_t& stats, std::ostream* out)
+{
+    auto later = [](const merge_cursor_t& a, const merge_cursor_t& b)
+    {
+        uint64_t a_offset = a.cur->ip - a.low, b_offset = b.cur->ip - b.low;
+        return a_offset != b_offset ? a_offset > b_offset : a.cur->element > b.cur->element;
+    };
+    std::priority_queue<merge_cursor_t, std::vector<merge_cursor_t>, decltype(later)> heap(later);
+    for (auto it = job.ranges.begin(); it != job.ranges.end(); ++it)
+        if (it->cur != it->end)
+            heap.push(*it);
+
+    // state of the current offset in each input; an input can map an
+    // image twice, in which case its records are combined
+    std::vector<uint64_t> stamp(num_inputs, 0);
+    std::vector<uint8_t> state(num_inputs);
+    uint64_t key_serial = 0;
+
+    stats.seen_in.assign(num_inputs, 0);
+
+    while (!heap.empty())
+    {
+        uint64_t offset = heap.top().cur->ip - heap.top().low;
+        uint8_t element = heap.top().cur->element;
+        key_serial++;
+
+        uint32_t inputs = 0;
+        uint64_t count = 0;
+        uint8_t load_type = heap.top().cur->load_type;
+        uint8_t sizeb = heap.top().cur->sizeb;
+        uint64_t val = 0, addr = 0;
+        bool same_value = true, same_addr = true;
+        bool has_value = false;
+
+        while (!heap.empty() && heap.top().cur->ip - heap.top().low == offset && heap.top().cur->element == element)
+        {
+            merge_cursor_t c = heap.top();
+            heap.pop();
+
+            const load_profile_record_t& rec = *c.cur;
+            if (stamp[c.input] != key_serial)
+            {
+                stamp[c.input] = key_serial;
+                state[c.input] = rec.state;
+                inputs++;
+            }
+            else if (rec.state == PROFILE_UNSTABLE || state[c.input] == PROFILE_SEEN_ONCE)
+                state[c.input] = rec.state;
+
+            count += rec.count;
+            // the one value of a seen-once record counts too, as it
+            // would have in a single run over all the inputs
+            if (rec.state != PROFILE_UNSTABLE)
+            {
+                same_value = same_value && (!has_value || rec.val == val);
+                same_addr = same_addr && (!has_value || rec.addr == addr);
+                val = rec.val;
+                addr = rec.addr;
+                has_value = true;
+            }
+
+            if (++c.cur != c.end)
+                heap.push(c);
+        }
+
+        uint32_t stable_inputs = 0, unstable_inputs = 0;
+        for (uint32_t i = 0; i < num_inputs; i++)
+        {
+            stable_inputs += (stamp[i] == key_serial && state[i] == PROFILE_STABLE);
+            unstable_inputs += (stamp[i] == key_serial && state[i] == PROFILE_UNSTABLE);
+        }
+
+        // a PC every input executed only once is stable, as in a single
+        // run over all the inputs, if they all loaded the same value
+        // from the same address
+        bool stable_seen_once = !stable_inputs && !unstable_inputs && same_value && same_addr && count > 1;
+
+        merge_class_t mclass = (!stable_inputs && !stable_seen_once) ? UNSTABLE_ALL_INPUTS :
+                               (unstable_inputs ? STABLE_SOME_INPUTS :
+                               (!(same_value && same_addr) ? STABLE_PER_INPUT :
+                               (inputs == num_inputs ? STABLE_ALL_INPUTS : STABLE_WHERE_SEEN)));
+
+        stats.union_ips++;
+        stats.intersection_ips += (inputs == num_inputs);
+        stats.classes[mclass]++;
+        stats.seen_in[inputs - 1]++;
+
+        if (out)
+            *out << csv_field(job.name)
+                 << ",0x" << std::hex << offset << std::dec
+                 << "," << load_type2str[load_type]
+                 << "," << (uint32_t)element
+                 << "," << load_size2str[sizeb]
+                 << "," << inputs
+                 << "," << stable_inputs
+                 << "," << unstable_inputs
+                 << "," << count
+                 << "," << (has_value && same_value)
+                 << "," << (has_value && same_addr)
+                 << "," << merge_class2str[mclass] << "\n";
+    }
+}
+
+static void usage(const char* prog)
+{
+    std::cerr << "usage: " << prog << " [-j threads] [-o merged.csv] <profile> ..." << std::endl;
+}
+
+int main(int argc, char* argv[])
+{
+    uint32_t num_threads = std::thread::hardware_concurrency();
+    std::string output;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "-j" && i + 1 < argc)
+            num_threads = strtoul(argv[++i], NULL, 0);
+        else if (arg == "-o" && i + 1 < argc)
+            output = argv[++i];
+        else if (arg[0] == '-')
+        {
+            usage(argv[0]);
+            return 1;
+        }
+        else
+            inputs.push_back(arg);
+    }
+    if (inputs.empty())
+    {
+        usage(argv[0]);
+        return 1;
+    }
+    num_threads = std::max(num_threads, 1u);
+
+    std::vector<std::unique_ptr<load_profile>> profiles;
+    for (auto it = inputs.begin(); it != inputs.end(); ++it)
+    {
+        profiles.emplace_back(new load_profile);
+        if (!profiles.back()->open(*it))
+        {
+            std::cerr << profiles.back()->error() << std::endl;
+            return 1;
+        }
+    }
+
+    // one job per image name, sorted by name
+    std::map<std::string, merge_job_t> jobs_by_name;
+    for (uint32_t input = 0; input < profiles.size(); input++)
+    {
+        const load_profile& profile = *profiles[input];
+        for (uint32_t i = 0; i < profile.num_images(); i++)
+        {
+            if (!profile.image(i).num_records)
+                continue;
+
+            merge_job_t& job = jobs_by_name[profile.image_name(i)];
+            job.name = profile.image_name(i);
+            job.ranges.push_back({ input, profile.image_begin(i), profile.image_end(i), profile.image(i).low });
+        }
+    }
+    std::vector<merge_job_t> jobs;
+    for (auto it = jobs_by_name.begin(); it != jobs_by_name.end(); ++it)
+        jobs.push_back(std::move(it->second));
+
+    // each job streams its rows into its own part file, so nothing
+    // but the cursors is held in memory
+    std::vector<merge_stats_t> job_stats(jobs.size());
+    std::atomic<size_t> next_job(0);
+    std::atomic<bool> write_failed(false);
+
+    auto worker = [&]()
+    {
+        for (size_t j = next_job++; j < jobs.size(); j = next_job++)
+        {
+            std::ofstream part;
+            if (!output.empty())
+            {
+                part.open(part_filename(output, j).c_str());
+                if (!part)
+                    write_failed = true;
+            }
+            merge_image(jobs[j], profiles.size(), job_stats[j], output.empty() ? NULL : &part);
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (uint32_t t = 0; t < std::min<size_t>(num_threads, jobs.size()); t++)
+        workers.emplace_back(worker);
+    for (auto it = workers.begin(); it != workers.end(); ++it)
+        it->join();
+
+    if (write_failed)
+    {
+        std::cerr << "cannot write " << output << std::endl;
+        return 1;
+    }
+
+    if (!output.empty())
+    {
+        std::ofstream merged(output.c_str());
+        merged << "image,offset,load_type,element,size,inputs,stable_inputs,unstable_inputs,count,same_value,same_addr,class" << std::endl;
+        for (size_t j = 0; j < jobs.size(); j++)
+        {
+            std::ifstream part(part_filename(output, j).c_str());
+            merged << part.rdbuf();
+            part.close();
+            remove(part_filename(output, j).c_str());
+        }
+    }
+
+    merge_stats_t total;
+    total.seen_in.assign(profiles.size(), 0);
+    for (auto it = job_stats.begin(); it != job_stats.end(); ++it)
+    {
+        total.union_ips += it->union_ips;
+        total.intersection_ips += it->intersection_ips;
+        for (int c = 0; c < NUM_MERGE_CLASSES; c++)
+            total.classes[c] += it->classes[c];
+        for (size_t k = 0; k < it->seen_in.size(); k++)
+            total.seen_in[k] += it->seen_in[k];
+    }
+
+    std::cout << "inputs " << profiles.size() << std::endl;
+    for (uint32_t input = 0; input < profiles.size(); input++)
+    {
+        uint64_t stable_ips = 0;
+        for (auto it = profiles[input]->begin(); it != profiles[input]->end(); ++it)
+            stable_ips += (it->state == PROFILE_STABLE);
+        std::cout << "input." << input << ".load_ips " << profiles[input]->size() << std::endl;
+        std::cout << "input." << input << ".stable_ips " << stable_ips << std::endl;
+    }
+    std::cout << "load_ips.union " << total.union_ips << std::endl;
+    std::cout << "load_ips.intersection " << total.intersection_ips << std::endl;
+    for (size_t k = 0; k < total.seen_in.size(); k++)
+        std::cout << "load_ips.seen_in." << (k + 1) << " " << total.seen_in[k] << std::endl;
+    for (int c = 0; c < NUM_MERGE_CLASSES; c++)
+        std::cout << "load_ips." << merge_class2str[c] << " " << total.classes[c] << std::endl;
+
+    return 0;
+}
@@ -6,6 +6,9 @@
 import argparse
 import matplotlib.pyplot as plt
 
+LOAD_TYPES = ["RIP", "STACK", "REG", "GATHER"]
+SIZES = ["1B", "2B", "4B", "8B", "16B", "32B", "64B"]
+
 def add_arguments(parser):
     parser.add_argument(
         "-i",
@@ -21,6 +24,18 @@ def add_arguments(parser):
         default="inspector.stats.png",
         help="Output file name",
     )
+    parser.add_argument(
+        "--intervals",
+        type=str,
+        default=None,
+        help="Interval snapshot file to plot as timelines",
+    )
+    parser.add_argument(
+        "--intervals-output",
+        type=str,
+        default="inspector.intervals.png",
+        help="Output file name of the interval timelines",
+    )
 
 
 def read_file_to_dict(file_path):
@@ -31,10 +46,60 @@ def read_file_to_dict(file_path):
             stripped_line = line.strip()
             if stripped_line:  # Check if the line is not empty
                 key, value = stripped_line.split(' ', 1)
-                result_dict[key] = (int)(value)
+                result_dict[key] = float(value) if '.' in value else int(value)
     
     return result_dict
 
+def sum_stats(stats, prefix, load_types, sizes):
+    """Sums <prefix>.<type>.<size> over the given types and sizes; missing
+    stats (e.g. GATHER in older stats files) count as zero"""
+    return sum(stats.get(prefix + "." + t + "." + s, 0) for t in load_types for s in sizes)
+
+def read_intervals(file_path):
+    columns = None
+    rows = []
+
+    with open(file_path, 'r') as file:
+        for line in file:
+            stripped_line = line.strip()
+            if stripped_line.startswith('#'):
+                columns = stripped_line[1:].split()
+            elif stripped_line:
+                rows.append([int(value) for value in stripped_line.split()])
+
+    return {name: [row[i] for row in rows] for i, name in enumerate(columns)}
+
+
+def plot_intervals(input_path, output_path):
+    intervals = read_intervals(input_path)
+    icount = intervals["icount"]
+
+    fig, axs = plt.subplots(3, 1, figsize=(12, 12), sharex=True)
+
+    # dynamic loads per interval by addressing mode
+    for load_type, color in zip(LOAD_TYPES, ['#ff9999', '#66b3ff', '#99ff99', '#ffcc99']):
+        loads = [sum(values) for values in zip(*[intervals[key] for key in intervals if key.startswith("load." + load_type + ".")])]
+        axs[0].plot(icount, loads, label=load_type, color=color)
+    axs[0].set_title('Loads per interval by addressing mode', fontsize=14, fontweight='bold', fontfamily='monospace')
+    axs[0].legend()
+
+    # stability transitions per interval
+    axs[1].plot(icount, intervals["new_stable_ips"], label="Newly stable", color='#ff9999')
+    axs[1].plot(icount, intervals["new_unstable_ips"], label="Newly unstable", color='#66b3ff')
+    axs[1].set_title('Load IP stability changes per interval', fontsize=14, fontweight='bold', fontfamily='monospace')
+    axs[1].legend()
+
+    # table size
+    axs[2].plot(icount, intervals["load_ips"], label="Load IPs", color='#ff9999')
+    axs[2].plot(icount, intervals["live_load_ips"], label="Live (not unstable) load IPs", color='#66b3ff')
+    axs[2].set_title('Load table size', fontsize=14, fontweight='bold', fontfamily='monospace')
+    axs[2].set_xlabel('Instruction count')
+    axs[2].legend()
+
+    plt.tight_layout()
+    plt.savefig(output_path, dpi=300)
+
+
 #########################
 # MAIN
 #########################
@@ -49,21 +114,23 @@ stats = read_file_to_dict(args.input)
 # Summarize stats
 non_vector_loads = stats["load.non_vector"]
 vector_loads = stats["load.vector"]
-rip_loads = stats["load.RIP.1B"] + stats["load.RIP.2B"] + stats["load.RIP.4B"] + stats["load.RIP.8B"] + stats["load.RIP.16B"] + stats["load.RIP.32B"] + stats["load.RIP.64B"]
-stack_loads = stats["load.STACK.1B"] + stats["load.STACK.2B"] + stats["load.STACK.4B"] + stats["load.STACK.8B"] + stats["load.STACK.16B"] + stats["load.STACK.32B"] + stats["load.STACK.64B"]
-reg_loads = stats["load.REG.1B"] + stats["load.REG.2B"] + stats["load.REG.4B"] + stats["load.REG.8B"] + stats["load.REG.16B"] + stats["load.REG.32B"] + stats["load.REG.64B"]
-loads_1B = stats["load.RIP.1B"] + stats["load.STACK.1B"] + stats["load.REG.1B"]
-loads_2B = stats["load.RIP.2B"] + stats["load.STACK.2B"] + stats["load.REG.2B"]
-loads_4B = stats["load.RIP.4B"] + stats["load.STACK.4B"] + stats["load.REG.4B"]
-loads_8B = stats["load.RIP.8B"] + stats["load.STACK.8B"] + stats["load.REG.8B"]
-loads_16B = stats["load.RIP.16B"] + stats["load.STACK.16B"] + stats["load.REG.16B"]
-loads_32B = stats["load.RIP.32B"] + stats["load.STACK.32B"] + stats["load.REG.32B"]
-loads_64B = stats["load.RIP.64B"] + stats["load.STACK.64B"] + stats["load.REG.64B"]
+rip_loads = sum_stats(stats, "load", ["RIP"], SIZES)
+stack_loads = sum_stats(stats, "load", ["STACK"], SIZES)
+reg_loads = sum_stats(stats, "load", ["REG"], SIZES)
+gather_loads = sum_stats(stats, "load", ["GATHER"], SIZES)
+loads_1B = sum_stats(stats, "load", LOAD_TYPES, ["1B"])
+loads_2B = sum_stats(stats, "load", LOAD_TYPES, ["2B"])
+loads_4B = sum_stats(stats, "load", LOAD_TYPES, ["4B"])
+loads_8B = sum_stats(stats, "load", LOAD_TYPES, ["8B"])
+loads_16B = sum_stats(stats, "load", LOAD_TYPES, ["16B"])
+loads_32B = sum_stats(stats, "load", LOAD_TYPES, ["32B"])
+loads_64B = sum_stats(stats, "load", LOAD_TYPES, ["64B"])
 global_stable_loads = stats["global_stable_loads.total"]
-non_global_stable_loads = non_vector_loads - global_stable_loads # since the tool only checks non-vector loads for stability
-global_stable_loads_rip = stats["global_stable_loads.RIP.1B"] + stats["global_stable_loads.RIP.2B"] + stats["global_stable_loads.RIP.4B"] + stats["global_stable_loads.RIP.8B"] + stats["global_stable_loads.RIP.16B"] + stats["global_stable_loads.RIP.32B"] + stats["global_stable_loads.RIP.64B"]
-global_stable_loads_stack = stats["global_stable_loads.STACK.1B"] + stats["global_stable_loads.STACK.2B"] + stats["global_stable_loads.STACK.4B"] + stats["global_stable_loads.STACK.8B"] + stats["global_stable_loads.STACK.16B"] + stats["global_stable_loads.STACK.32B"] + stats["global_stable_loads.STACK.64B"]
-global_stable_loads_reg = stats["global_stable_loads.REG.1B"] + stats["global_stable_loads.REG.2B"] + stats["global_stable_loads.REG.4B"] + stats["global_stable_loads.REG.8B"] + stats["global_stable_loads.REG.16B"] + stats["global_stable_loads.REG.32B"] + stats["global_stable_loads.REG.64B"]
+non_global_stable_loads = stats["load.total"] - global_stable_loads
+global_stable_loads_rip = sum_stats(stats, "global_stable_loads", ["RIP"], SIZES)
+global_stable_loads_stack = sum_stats(stats, "global_stable_loads", ["STACK"], SIZES)
+global_stable_loads_reg = sum_stats(stats, "global_stable_loads", ["REG"], SIZES)
+global_stable_loads_gather = sum_stats(stats, "global_stable_loads", ["GATHER"], SIZES)
 
 # Create a figure with six subplots
 fig, axs = plt.subplots(1, 5, figsize=(25, 5))
@@ -88,7 +155,7 @@ axs[1].pie([loads_1B, loads_2B, loads_4B, loads_8B, loads_16B, loads_32B, loads_
 axs[1].set_title('Loads by size', fontsize=14, fontweight='bold', fontfamily='monospace')
 
 # addressing-mode wise pie
-axs[2].pie([rip_loads, stack_loads, reg_loads], labels=["PC-rel", "Stack-rel", "Reg-rel"], colors=['#ff9999', '#66b3ff', '#99ff99'], explode=[0.02, 0.02, 0.02], **pie_kwargs)
+axs[2].pie([rip_loads, stack_loads, reg_loads, gather_loads], labels=["PC-rel", "Stack-rel", "Reg-rel", "Gather"], colors=['#ff9999', '#66b3ff', '#99ff99', '#ffcc99'], explode=[0.02, 0.02, 0.02, 0.02], **pie_kwargs)
 axs[2].set_title('Loads by addressing mode', fontsize=14, fontweight='bold', fontfamily='monospace')
 
 # Global-stable-load pie
@@ -96,7 +163,7 @@ axs[3].pie([global_stable_loads, non_global_stable_loads], labels=["Global-stabl
 axs[3].set_title('Global-stable loads', fontsize=14, fontweight='bold', fontfamily='monospace')
 
 # Global-stable loads by addressing mode
-axs[4].pie([global_stable_loads_rip, global_stable_loads_stack, global_stable_loads_reg], labels=["PC-rel", "Stack-rel", "Reg-rel"], colors=['#ff9999', '#66b3ff', '#99ff99'], explode=[0.02, 0.02, 0.02], **pie_kwargs)
+axs[4].pie([global_stable_loads_rip, global_stable_loads_stack, global_stable_loads_reg, global_stable_loads_gather], labels=["PC-rel", "Stack-rel", "Reg-rel", "Gather"], colors=['#ff9999', '#66b3ff', '#99ff99', '#ffcc99'], explode=[0.02, 0.02, 0.02, 0.02], **pie_kwargs)
 axs[4].set_title('Global-stable loads by addressing mode', fontsize=14, fontweight='bold', fontfamily='monospace')
 
 # Adjust layout to prevent overlap
@@ -105,5 +172,9 @@ plt.tight_layout(rect=[0, 0.03, 1, 0.95])
 # Save the figure as a PNG file
 plt.savefig(args.output, dpi=300)
 
+# Interval timelines
+if args.intervals:
+    plot_intervals(args.intervals, args.intervals_output)
+
 # Show the plot
 plt.show()
\ No newline at end of file